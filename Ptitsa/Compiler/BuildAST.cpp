@@ -5,47 +5,116 @@
 #include <vector>
 #include <algorithm>
 
-BuildAST::ASTNode::ASTNode():
-	lex(nullptr),
-	children()
+namespace
+{
+	BuildAST::Node::Kind kindOf(Lexer::PLexeme const & lex)
+	{
+		if (lex->isLiteral()) return BuildAST::Node::LITERAL;
+		if (lex->isVariable()) return BuildAST::Node::VARIABLE;
+		if (lex->isFunction()) return BuildAST::Node::FUNCTION;
+		return BuildAST::Node::OTHER;
+	}
+}
+
+BuildAST::Nodes::Children::Iterator::Iterator(Nodes const & owner, std::uint32_t position) :
+	owner(&owner),
+	position(position)
 { }
 
-BuildAST::ASTNode::ASTNode(Lexer::PLexeme const & lex):
-	lex(lex),
-	children()
+BuildAST::NodeIndex BuildAST::Nodes::Children::Iterator::operator*() const { return owner->childIndexes[position]; }
+BuildAST::Nodes::Children::Iterator & BuildAST::Nodes::Children::Iterator::operator++() { position++; return *this; }
+bool BuildAST::Nodes::Children::Iterator::operator!=(Iterator const & other) const { return position != other.position; }
+
+BuildAST::Nodes::Children::Children(Nodes const & owner, Node const & parent) :
+	owner(owner),
+	first(parent.firstChild),
+	count(parent.childCount)
 { }
 
+BuildAST::Nodes::Children::Iterator BuildAST::Nodes::Children::begin() const { return Iterator(owner, first); }
+BuildAST::Nodes::Children::Iterator BuildAST::Nodes::Children::end() const { return Iterator(owner, first + count); }
+
+BuildAST::Nodes::Nodes() :
+	nodes(),
+	lexemes(),
+	childIndexes()
+{ }
+
+std::uint32_t BuildAST::Nodes::addLexeme(Lexer::PLexeme const & lex)
+{
+	lexemes.push_back(lex);
+	return static_cast<std::uint32_t>(lexemes.size() - 1);
+}
+
+BuildAST::NodeIndex BuildAST::Nodes::add(Lexer::PLexeme const & lex)
+{
+	nodes.push_back({ kindOf(lex), addLexeme(lex), 0, 0 });
+	return static_cast<NodeIndex>(nodes.size() - 1);
+}
+
+BuildAST::NodeIndex BuildAST::Nodes::add(Lexer::PLexeme const & lex, std::vector<NodeIndex> const & children)
+{
+	NodeIndex const node = add(lex);
+	setChildren(node, children);
+	return node;
+}
+
+BuildAST::NodeIndex BuildAST::Nodes::addEmpty()
+{
+	nodes.push_back({ Node::EMPTY, 0, 0, 0 });
+	return static_cast<NodeIndex>(nodes.size() - 1);
+}
 
-BuildAST::ASTNode::ASTNode(BuildAST::ASTNode && temp) :
-	lex(temp.lex),
-	children(std::move(temp.children))
+BuildAST::NodeIndex BuildAST::Nodes::copyOf(NodeIndex node)
 {
-	temp.children.clear();
-	temp.lex = nullptr;
+	std::vector<NodeIndex> children;
+	for (NodeIndex const child : this->children(node)) children.push_back(copyOf(child));
+
+	NodeIndex const copy = moveToNew(node);
+	setChildren(copy, children);
+	return copy;
 }
 
-BuildAST::ASTNode::ASTNode(Lexer::PLexeme const & lex, std::vector<BuildAST::PASTNode> && tempChildren) :
-	lex(lex),
-	children(std::move(tempChildren))
+BuildAST::NodeIndex BuildAST::Nodes::moveToNew(NodeIndex node)
 {
-	tempChildren.clear();
+	Node const moved = nodes[node]; // push_back may move the vector, so not a reference
+	nodes.push_back(moved);
+	return static_cast<NodeIndex>(nodes.size() - 1);
 }
 
-BuildAST::ASTNode::~ASTNode() { }
+void BuildAST::Nodes::replace(NodeIndex node, NodeIndex with) { nodes[node] = nodes[with]; }
 
-void BuildAST::ASTNode::add(BuildAST::PASTNode && node) 
-{ 
-	children.push_back(std::move(node));
-	node = nullptr;
+void BuildAST::Nodes::setChildren(NodeIndex node, std::vector<NodeIndex> const & children)
+{
+	nodes[node].firstChild = static_cast<std::uint32_t>(childIndexes.size());
+	nodes[node].childCount = static_cast<std::uint32_t>(children.size());
+	childIndexes.insert(childIndexes.end(), children.begin(), children.end());
 }
 
+BuildAST::Node::Kind BuildAST::Nodes::kind(NodeIndex node) const { return nodes[node].kind; }
+bool BuildAST::Nodes::isEmpty(NodeIndex node) const { return nodes[node].kind == Node::EMPTY; }
+Lexer::PLexeme const & BuildAST::Nodes::lexeme(NodeIndex node) const { return lexemes[nodes[node].lexeme]; }
+Lexer::Function const & BuildAST::Nodes::function(NodeIndex node) const { return *std::static_pointer_cast<Lexer::Function>(lexeme(node)); }
+Lexer::Literal const & BuildAST::Nodes::literal(NodeIndex node) const { return *std::static_pointer_cast<Lexer::Literal>(lexeme(node)); }
+Lexer::Variable const & BuildAST::Nodes::variable(NodeIndex node) const { return *std::static_pointer_cast<Lexer::Variable>(lexeme(node)); }
+
+std::uint32_t BuildAST::Nodes::childCount(NodeIndex node) const { return nodes[node].childCount; }
+BuildAST::NodeIndex BuildAST::Nodes::child(NodeIndex node, std::uint32_t i) const { return childIndexes[nodes[node].firstChild + i]; }
+BuildAST::Nodes::Children BuildAST::Nodes::children(NodeIndex node) const { return Children(*this, nodes[node]); }
 
-void BuildAST::generateAST(Lexer::LexemeLine const & line, BuildAST::PASTNode & root)
+std::size_t BuildAST::Nodes::size() const { return nodes.size(); }
+
+std::size_t BuildAST::Nodes::bytesUsed() const
+{
+	return nodes.capacity() * sizeof(Node) + lexemes.capacity() * sizeof(Lexer::PLexeme) + childIndexes.capacity() * sizeof(NodeIndex);
+}
+
+BuildAST::NodeIndex BuildAST::generateAST(Lexer::LexemeLine const & line, BuildAST::Nodes & nodes)
 {
 	using namespace Lexer;
 	using std::static_pointer_cast;
 
-	if (line.size() < 1) return;
+	if (line.size() < 1) return nodes.addEmpty();
 
 	unsigned maxOrder = 0;
 	unsigned maxOrderIdx = 0;
@@ -67,52 +136,47 @@ void BuildAST::generateAST(Lexer::LexemeLine const & line, BuildAST::PASTNode &
 
 	if (functionFound)
 	{
-		root->lex = line[maxOrderIdx];
-		Function const fn = * static_pointer_cast<Function>(root->lex);
+		NodeIndex const root = nodes.add(line[maxOrderIdx]); // before its children, so a tree is mostly laid out parent first
+		Function const fn = * static_pointer_cast<Function>(line[maxOrderIdx]);
+		std::vector<NodeIndex> children;
 
 		if (fn.type == Lexer::Function::PREFIX) // is prefix function
 		{
 			const std::vector<std::vector<Lexer::PLexeme>> args = Util::commandArguments(line, maxOrderIdx - 1);
 			for (const std::vector<Lexer::PLexeme>& argument : args)
 			{
-				PASTNode node = std::make_unique<ASTNode>();
 				const Lexer::LexemeLine argAsLexemeLine(argument);
-				generateAST(argAsLexemeLine, node);
-				root->add(std::move(node));
+				children.push_back(generateAST(argAsLexemeLine, nodes));
 			}
 		}
 		else if (fn.type == Lexer::Function::INFIX) // is two-arg operator
 		{
 			Lexer::LexemeLine const leftArgs = line.makeCopyBetween(0, maxOrderIdx - 1); // End NOT inclusive, hence no -1
-			PASTNode leftArgsNodes = std::make_unique<ASTNode>();
-			generateAST(leftArgs, leftArgsNodes);
-			root->add(std::move(leftArgsNodes));
+			children.push_back(generateAST(leftArgs, nodes));
 
 			Lexer::LexemeLine const rightArgs = line.makeCopyBetween(maxOrderIdx + 1, line.size() - 1);
-			PASTNode rightArgsNodes = std::make_unique<ASTNode>();
-			generateAST(rightArgs, rightArgsNodes);
-			root->add(std::move(rightArgsNodes));
+			children.push_back(generateAST(rightArgs, nodes));
 		}
+
+		nodes.setChildren(root, children);
+		return root;
 	}
 
 	else
 	{
+		Lexer::PLexeme value = nullptr;
 		for (Lexer::PLexeme const & lex : line)
 		{
-			if (!lex->isSymbol()) root->lex = lex;
+			if (!lex->isSymbol()) value = lex;
 		}
+		return value ? nodes.add(value) : nodes.addEmpty();
 	}
 }
 
-void BuildAST::setASTs(std::vector<Lexer::LexemeLine> const & lexemeDoc, std::vector<PASTNode> & nodes)
+void BuildAST::setASTs(std::vector<Lexer::LexemeLine> const & lexemeDoc, BuildAST::Nodes & nodes, std::vector<BuildAST::NodeIndex> & roots)
 {
 	for (Lexer::LexemeLine const & line : lexemeDoc)
 	{
-		if (line.isNotEmpty())
-		{
-			PASTNode node = std::make_unique<ASTNode>();
-			generateAST(line, node);
-			nodes.push_back(std::move(node));
-		}
+		if (line.isNotEmpty()) roots.push_back(generateAST(line, nodes));
 	}
 }
@@ -3,32 +3,89 @@
 
 #include "Lexer.h"
 #include <iostream>
-#include <memory>
+#include <cstdint>
+#include <cstddef>
 #include <vector>
 
 namespace BuildAST
 {
-	struct ASTNode;
-	typedef std::unique_ptr<ASTNode> PASTNode;
+	typedef std::uint32_t NodeIndex;
 
-	struct ASTNode 
+	// A node of a syntax tree. It is plain data: its lexeme and its children are indexes into the Nodes holding it,
+	// and the kind of lexeme is kept here so that walking a tree does not have to ask the lexeme
+	struct Node
 	{
-		Lexer::PLexeme lex;
-		std::vector<PASTNode> children;
+		enum Kind : std::uint8_t { EMPTY, LITERAL, VARIABLE, FUNCTION, OTHER } kind;
+		std::uint32_t lexeme;
+		std::uint32_t firstChild; // where the indexes of its children start in the list of children
+		std::uint32_t childCount;
+	};
+
+	// The nodes of every syntax tree in a program, side by side in one vector, so making a node is not an allocation
+	// of its own and freeing them all is one. A tree is known by the index of its root.
+	// Nodes are never removed: a subtree that is replaced stays where it was, unreachable, so an index stays valid
+	class Nodes
+	{
+	public:
+		class Children
+		{
+		public:
+			class Iterator
+			{
+			public:
+				Iterator(Nodes const & owner, std::uint32_t position);
+				NodeIndex operator*() const;
+				Iterator & operator++();
+				bool operator!=(Iterator const & other) const;
+
+			private:
+				Nodes const * owner;
+				std::uint32_t position;
+			};
+
+			Children(Nodes const & owner, Node const & parent);
+			Iterator begin() const;
+			Iterator end() const;
+
+		private:
+			Nodes const & owner;
+			std::uint32_t first, count;
+		};
 
-		ASTNode();
-		ASTNode(Lexer::PLexeme const & lex);
-		ASTNode(ASTNode const & copy) = delete;
-		ASTNode(ASTNode && temp);
-		ASTNode(Lexer::PLexeme const & lex, std::vector<PASTNode> && tempChildren);
+		Nodes();
 
-		~ASTNode();
+		NodeIndex add(Lexer::PLexeme const & lex);
+		NodeIndex add(Lexer::PLexeme const & lex, std::vector<NodeIndex> const & children);
+		NodeIndex addEmpty();
+		NodeIndex copyOf(NodeIndex node); // the whole subtree, sharing its lexemes
+		NodeIndex moveToNew(NodeIndex node); // what the node holds, under a new index, leaving the old one free to be replaced
+		void replace(NodeIndex node, NodeIndex with); // the node holds what `with` does, children and all
+		void setChildren(NodeIndex node, std::vector<NodeIndex> const & children);
 
-		void add(PASTNode && node);
+		Node::Kind kind(NodeIndex node) const;
+		bool isEmpty(NodeIndex node) const;
+		Lexer::PLexeme const & lexeme(NodeIndex node) const;
+		Lexer::Function const & function(NodeIndex node) const;
+		Lexer::Literal const & literal(NodeIndex node) const;
+		Lexer::Variable const & variable(NodeIndex node) const;
+
+		std::uint32_t childCount(NodeIndex node) const;
+		NodeIndex child(NodeIndex node, std::uint32_t i) const;
+		Children children(NodeIndex node) const;
+
+		std::size_t size() const;
+		std::size_t bytesUsed() const; // by the nodes, their lexeme pointers and their lists of children, not by the lexemes
+
+	private:
+		std::vector<Node> nodes;
+		std::vector<Lexer::PLexeme> lexemes;
+		std::vector<NodeIndex> childIndexes;
+
+		std::uint32_t addLexeme(Lexer::PLexeme const & lex);
 	};
-		
-	void generateAST(Lexer::LexemeLine const &, PASTNode &);
-	void setASTs(std::vector<Lexer::LexemeLine> const & lexemeDoc, std::vector<PASTNode> & nodes);
+
+	NodeIndex generateAST(Lexer::LexemeLine const &, Nodes &);
+	void setASTs(std::vector<Lexer::LexemeLine> const & lexemeDoc, Nodes & nodes, std::vector<NodeIndex> & roots);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -4,22 +4,111 @@
 #include "BuildContextTree.h"
 #include "BuildAST.h"
 
-BuildContextTree::ContextTree::ContextTree(Lexer::LexemeLine::Type type, BuildAST::PASTNode && root) :
-	type(type),
-	root(std::move(root)) 
+namespace
 {
-	root = nullptr;
+	using BuildAST::Nodes;
+	using BuildAST::NodeIndex;
+
+	bool isFunctionNamed(Nodes const & nodes, NodeIndex node, std::string const & identifier)
+	{
+		return nodes.kind(node) == BuildAST::Node::FUNCTION && nodes.function(node).identifier == identifier;
+	}
+
+	bool isComparison(Nodes const & nodes, NodeIndex node)
+	{
+		return (isFunctionNamed(nodes, node, "is") || isFunctionNamed(nodes, node, "isnt")) && nodes.childCount(node) == 2;
+	}
+
+	// Anything that is already true or false by itself, so is not one of the alternatives in `x is a or b`
+	bool isCondition(Nodes const & nodes, NodeIndex node)
+	{
+		for (std::string const identifier : { "is", "isnt", "and", "or", "not" })
+		{
+			if (isFunctionNamed(nodes, node, identifier)) return true;
+		}
+		return false;
+	}
+
+	Lexer::PLexeme functionNamed(std::string const & identifier)
+	{
+		Lexer::PFunction fn = std::make_shared<Lexer::Function>();
+		Lexer::couldSetBuiltinFromName(*fn, identifier);
+		return fn;
+	}
+
+	NodeIndex infix(Nodes & nodes, std::string const & identifier, NodeIndex left, NodeIndex right)
+	{
+		return nodes.add(functionNamed(identifier), { left, right });
+	}
+
+	// `a or b or c` is built left-nested, as ((a or b) or c)
+	void collectOrChain(Nodes const & nodes, NodeIndex node, std::vector<NodeIndex> & operands)
+	{
+		if (isFunctionNamed(nodes, node, "or") && nodes.childCount(node) == 2)
+		{
+			collectOrChain(nodes, nodes.child(node, 0), operands);
+			operands.push_back(nodes.child(node, 1));
+		}
+		else operands.push_back(node);
+	}
+
+	// `x is 12 or 13` is the same as `x is 12 or x is 13`, so each alternative after a comparison gets the comparison's subject.
+	// `x isnt 12 or 13` reads as x being neither, so becomes `x isnt 12 and x isnt 13`
+	void expandAlternatives(Nodes & nodes, NodeIndex node)
+	{
+		if (!isFunctionNamed(nodes, node, "or") || nodes.childCount(node) != 2)
+		{
+			for (NodeIndex const child : nodes.children(node)) expandAlternatives(nodes, child);
+			return;
+		}
+
+		std::vector<NodeIndex> operands;
+		collectOrChain(nodes, node, operands);
+		for (NodeIndex const operand : operands) expandAlternatives(nodes, operand);
+
+		std::vector<NodeIndex> joined;
+		std::string comparison; // of the last comparison, while its alternatives follow it
+		NodeIndex subject = 0;
+		bool hasSubject = false;
+		for (NodeIndex const operand : operands)
+		{
+			if (hasSubject && !isCondition(nodes, operand))
+			{
+				NodeIndex const alternative = infix(nodes, comparison, nodes.copyOf(subject), operand);
+				if (comparison == "isnt") joined.back() = infix(nodes, "and", joined.back(), alternative);
+				else joined.push_back(alternative);
+				continue;
+			}
+
+			hasSubject = isComparison(nodes, operand);
+			if (hasSubject)
+			{
+				comparison = nodes.function(operand).identifier;
+				subject = nodes.child(operand, 0);
+			}
+			joined.push_back(operand);
+		}
+
+		NodeIndex chain = joined[0];
+		for (unsigned i = 1; i < joined.size(); i++) chain = infix(nodes, "or", chain, joined[i]);
+		nodes.replace(node, chain);
+	}
 }
 
-std::vector<BuildContextTree::ContextTree> BuildContextTree::generateContextTrees(std::vector<Lexer::LexemeLine> const & lexemeDoc)
+BuildContextTree::ContextTree::ContextTree(Lexer::LexemeLine::Type type, unsigned row, BuildAST::NodeIndex root) :
+	type(type),
+	row(row),
+	root(root) 
+{ }
+
+std::vector<BuildContextTree::ContextTree> BuildContextTree::generateContextTrees(std::vector<Lexer::LexemeLine> const & lexemeDoc, BuildAST::Nodes & nodes)
 {
 	std::vector<ContextTree> trees;
 	for (Lexer::LexemeLine const & line : lexemeDoc)
 	{
-		BuildAST::PASTNode node = std::make_unique<BuildAST::ASTNode>();
-		BuildAST::generateAST(line, node);
-		ContextTree tree(line.type, std::move(node));
-		trees.push_back(std::move(tree));
+		BuildAST::NodeIndex const root = BuildAST::generateAST(line, nodes);
+		if (!nodes.isEmpty(root)) expandAlternatives(nodes, root);
+		trees.push_back(ContextTree(line.type, line.row, root));
 	}
 	return trees;
 }
\ No newline at end of file
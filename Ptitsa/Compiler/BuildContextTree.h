@@ -10,12 +10,14 @@ namespace BuildContextTree
 	struct ContextTree
 	{
 		Lexer::LexemeLine::Type type;
-		BuildAST::PASTNode root;
+		unsigned row;
+		BuildAST::NodeIndex root;
 
-		ContextTree(Lexer::LexemeLine::Type type, BuildAST::PASTNode && root);
+		ContextTree(Lexer::LexemeLine::Type type, unsigned row, BuildAST::NodeIndex root);
 	};
 
-	std::vector<ContextTree> generateContextTrees(std::vector<Lexer::LexemeLine> const & lexemeDoc);
+	// The trees' nodes are added to `nodes`
+	std::vector<ContextTree> generateContextTrees(std::vector<Lexer::LexemeLine> const & lexemeDoc, BuildAST::Nodes & nodes);
 }
 
 #endif // !CONTEXT_TREE_INCLUDE 
@@ -0,0 +1,37 @@
+#include <string>
+
+#include "Compiler.h"
+#include "Lexer.h"
+
+Ptitsa::Compiler::Compiler(InterpretTree::Options const & options, unsigned splitInto) :
+	options(options),
+	splitInto(splitInto)
+{ }
+
+std::vector<BuildContextTree::ContextTree> Ptitsa::Compiler::parse(std::string_view source, BuildAST::Nodes & nodes) const
+{
+	std::vector<Lexer::LexemeLine> lexemeDoc = Lexer::createTypedLexemes(std::string(source));
+	Lexer::parseTypedLexemes(lexemeDoc);
+	return BuildContextTree::generateContextTrees(lexemeDoc, nodes);
+}
+
+Optimise::Statistics Ptitsa::Compiler::generate(BuildAST::Nodes & nodes, std::vector<BuildContextTree::ContextTree> & trees, Sink const & sink) const
+{
+	Optimise::Statistics statistics;
+	Optimise::hoistLoopInvariants(nodes, trees, statistics);
+	Optimise::eliminateCommonSubexpressions(nodes, trees, statistics);
+
+	if (splitInto > 0)
+	{
+		for (InterpretTree::SourceFile const & file : InterpretTree::treesToFiles(nodes, trees, options, splitInto)) sink(file);
+	}
+	else sink({ "program.cpp", InterpretTree::treesToString(nodes, trees, options) });
+	return statistics;
+}
+
+Optimise::Statistics Ptitsa::Compiler::compile(std::string_view source, Sink const & sink) const
+{
+	BuildAST::Nodes nodes;
+	std::vector<BuildContextTree::ContextTree> trees = parse(source, nodes);
+	return generate(nodes, trees, sink);
+}
@@ -0,0 +1,43 @@
+#ifndef COMPILER_INCLUDE
+#define COMPILER_INCLUDE
+
+#include <string_view>
+#include <functional>
+#include <vector>
+
+#include "BuildAST.h"
+#include "BuildContextTree.h"
+#include "InterpretTree.h"
+#include "Optimise.h"
+
+// The compiler as a library, for programs that compile Ptitsa themselves rather than running the command line tool.
+// It reads no files and writes none: the source comes in as a string, and the C++ goes out to a sink
+namespace Ptitsa
+{
+	// Given each generated file, in order. The file is only valid for the call
+	typedef std::function<void(InterpretTree::SourceFile const &)> Sink;
+
+	// Holds only its settings, so one Compiler can compile many programs on many threads at once.
+	// Everything a compile learns about its program, like the commands it declares, lives only as long as that compile
+	class Compiler
+	{
+	public:
+		// `splitInto` is how many files the program's code is spread over, or 0 for the one program.cpp
+		explicit Compiler(InterpretTree::Options const & options, unsigned splitInto = 0);
+
+		// Lexes and parses the source into `nodes`. Throws a Mistake if the source is not a valid program
+		std::vector<BuildContextTree::ContextTree> parse(std::string_view source, BuildAST::Nodes & nodes) const;
+
+		// Optimises parsed trees and gives the C++ for them to the sink
+		Optimise::Statistics generate(BuildAST::Nodes & nodes, std::vector<BuildContextTree::ContextTree> & trees, Sink const & sink) const;
+
+		// Both of the above
+		Optimise::Statistics compile(std::string_view source, Sink const & sink) const;
+
+	private:
+		InterpretTree::Options options;
+		unsigned splitInto;
+	};
+}
+
+#endif // !COMPILER_INCLUDE
@@ -3,45 +3,19 @@
 
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <iterator>
+#include <string_view>
 #include "Lexer.h"
+#include "Vocabulary.h"
 #include "Util.h"
-
-std::vector<std::vector<Lexer::Function>> const Lexer::opsBeforeCommands = {
-	{ Lexer::Function("^", "^", Lexer::Function::INFIX) },
-	{
-		Lexer::Function("*", "*", Lexer::Function::INFIX),
-		Lexer::Function("/", "/", Lexer::Function::INFIX)
-	},
-	{
-		Lexer::Function("+", "+", Lexer::Function::INFIX),
-		Lexer::Function("-", "-", Lexer::Function::INFIX)
-	}
-};
-
-std::vector<std::vector<Lexer::Function>> const Lexer::opsAfterCommands({
-	{
-		Lexer::Function("is", "==", Lexer::Function::INFIX),
-		Lexer::Function("isnt", "!=", Lexer::Function::INFIX)
-	},
-	{ Lexer::Function("and", "&&", Lexer::Function::INFIX) },
-	{ Lexer::Function("or", "||", Lexer::Function::INFIX) },
-	{ Lexer::Function("not", "!", Lexer::Function::PREFIX, 1) },
-	{ Lexer::Function("=", "=", Lexer::Function::INFIX) }
-	});
-
-std::vector<Lexer::Function> Lexer::commands({
-	Lexer::Function("not", "!", Lexer::Function::PREFIX, 1),
-	Lexer::Function("show", "Library::show", Lexer::Function::PREFIX, -1),
-	Lexer::Function("exp", "Library::exp", Lexer::Function::PREFIX, 1)
-});
+#include "Mistake.h"
 
 namespace
 {
 	using namespace Lexer;
 	using std::static_pointer_cast;
 
-	std::set<Variable> definedVariables = { };
-
 	// 'Utility ' functions
 	unsigned depthOfLine(LexemeLine const & lexemeLine)
 	{
@@ -77,38 +51,6 @@ namespace
 		return true;
 	}
 
-	bool groupContainsName(std::vector<Function> const & group, std::string const & name)
-	{
-		for (Function const & function : group)
-		{
-			if (function.identifier == name) return true;
-		}
-		return false;
-	}
-
-	bool groupSetContainsName(std::vector<std::vector<Function>> const & groups, std::string const & identifier)
-	{
-		for (std::vector<Function> const & opGroup : groups)
-		{
-			if (groupContainsName(opGroup, identifier)) return true;
-		}
-		return false;
-	}
-
-	bool commandExistsWithName(std::string const & identifier)
-	{
-		for (Function const & command : commands)
-		{
-			if (command.identifier == identifier) return true;
-		}
-		return false;
-	}
-
-	bool functionExistsWithName(std::string const & identifier)
-	{
-		return groupSetContainsName(opsBeforeCommands, identifier) || groupSetContainsName(opsAfterCommands, identifier) || commandExistsWithName(identifier);
-	}
-
 	std::set<std::string> commandArgNames(LexemeLine & line)
 	{
 		std::set<std::string> arguments;
@@ -150,12 +92,16 @@ namespace
 	{
 		std::vector<LexemeLine> lexemeDoc;
 
-		for (std::vector<std::string> const & codeLine : codeDoc)
+		for (unsigned r = 0; r < codeDoc.size(); r++)
 		{
 			std::vector<PLexeme> lexemes;
-			for (std::string const & word : codeLine) lexemes.push_back(std::make_shared<RawLexeme>(word));
+			for (std::string const & word : codeDoc[r]) lexemes.push_back(std::make_shared<RawLexeme>(word));
 
-			if (!lexemes.empty()) lexemeDoc.emplace_back<LexemeLine>(lexemes);
+			if (!lexemes.empty())
+			{
+				lexemeDoc.emplace_back<LexemeLine>(lexemes);
+				lexemeDoc.back().row = r + 1;
+			}
 		}
 
 		return lexemeDoc;
@@ -243,14 +189,44 @@ namespace
 			if (lex->isRaw())
 			{
 				std::string const id = static_pointer_cast<RawLexeme>(lex)->value;
-				if (Symbol::idsToSymbols.count(id))
+				if (Symbol::Type const * type = Vocabulary::symbols.find(id))
 				{
-					lex = std::make_shared<Symbol>(Symbol::idsToSymbols.at(id));
+					lex = std::make_shared<Symbol>(*type);
 				}
 			}
 		}
 	}
 
+	bool isRawWord(LexemeLine const & line, unsigned i, std::string const & word)
+	{
+		return i < line.size() && line[i]->isRaw() && static_pointer_cast<RawLexeme>(line[i])->value == word;
+	}
+
+	// `for each x in items`, or `for each parallel x in items`, becomes the keyword followed by `x in items`,
+	// with `in` as an operator joining the loop's variable to the list, so the line's tree is in(x, items).
+	// The variable belongs to the loop's body, as a command's arguments belong to its body
+	void identifyForEachLoops(LexemeLine & line, unsigned row)
+	{
+		unsigned const start = depthOfLine(line);
+		unsigned wordsInKeyword;
+		if (isRawWord(line, start, "for") && isRawWord(line, start + 1, "each")) wordsInKeyword = 2;
+		else if (isRawWord(line, start, "foreach")) wordsInKeyword = 1;
+		else return;
+
+		bool const isParallel = isRawWord(line, start + wordsInKeyword, "parallel");
+		if (isParallel) wordsInKeyword++;
+
+		unsigned const variableIdx = start + wordsInKeyword;
+		if (!isRawWord(line, variableIdx + 1, "in") || !line[variableIdx]->isRaw()) return;
+
+		std::string const variableName = static_pointer_cast<RawLexeme>(line[variableIdx])->value;
+		line[variableIdx] = std::make_shared<Variable>(variableName, row + 1, line.depth + 1);
+		line[variableIdx + 1] = std::make_shared<Function>("in", "in", Function::INFIX, 2, Function::ASSIGNMENT);
+
+		for (unsigned i = 1; i < wordsInKeyword; i++) line.erase(start + 1);
+		line[start] = std::make_shared<Keyword>(isParallel ? Keyword::PARALLEL_FOR_EACH : Keyword::FOR_EACH);
+	}
+
 	void identifyKeywords(LexemeLine & line)
 	{
 		for (PLexeme & lex : line)
@@ -258,42 +234,118 @@ namespace
 			if (lex->isRaw())
 			{
 				std::string const value = static_pointer_cast<RawLexeme>(lex)->value;
-				if (Keyword::valuesToKeywordTypes.count(value))
+				if (Keyword::Type const * type = Vocabulary::keywords.find(value))
 				{
-					lex = std::make_shared<Keyword>(Keyword::valuesToKeywordTypes.at(value));
+					lex = std::make_shared<Keyword>(*type);
 				}
 			}
 		}
 	}
 
-	void identifyCommandDeclarations(LexemeLine & line, unsigned row)
+	// Some builtins are named by two words, like `read lines`. The words are joined into one, to be found like any other name
+	void joinTwoWordNames(LexemeLine & line)
+	{
+		for (unsigned i = 0; i + 1 < line.size(); i++)
+		{
+			if (!line[i]->isRaw() || !line[i + 1]->isRaw()) continue;
+
+			std::string const name = static_pointer_cast<RawLexeme>(line[i])->value + " " + static_pointer_cast<RawLexeme>(line[i + 1])->value;
+			if (Vocabulary::functions.find(name))
+			{
+				line[i] = std::make_shared<RawLexeme>(name);
+				line.erase(i + 1);
+			}
+		}
+	}
+
+	// Words C++ keeps for itself, which a command and its arguments are named as in the C++
+	std::string_view const cppKeywords[] = {
+		"alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case", "catch", "char", "char8_t", "char16_t",
+		"char32_t", "class", "compl", "concept", "const", "consteval", "constexpr", "constinit", "const_cast", "continue", "co_await", "co_return",
+		"co_yield", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float",
+		"for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator",
+		"or", "or_eq", "private", "protected", "public", "register", "reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static",
+		"static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef", "typeid",
+		"typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq" };
+
+	bool isCppKeyword(std::string const & name) { return std::find(std::begin(cppKeywords), std::end(cppKeywords), name) != std::end(cppKeywords); }
+
+	// A command becomes a C++ function of the same name, and its arguments its parameters, next to the `result` it gives back
+	void checkCommandNames(LexemeLine const & line, std::string const & commandName, std::set<std::string> const & argNames)
 	{
-		if (line.size() >= 2 && line[0]->isRaw() && line[1]->isSymbol())
+		if (isCppKeyword(commandName) || commandName == "main")
 		{
-			int argCount = 0;
-			for (std::string const & argName : commandArgNames(line))
-			{				
-				Variable arg = Variable(argName, row + 1, line.depth + 1); // let the argument be defined in function's scope
-				definedVariables.insert(arg);
-				argCount++;
+			throw Mistake::Bad_Variable_Name("A command cannot be named '" + commandName + "', as the C++ it becomes already uses the name.", line.row);
+		}
+		for (std::string const & argName : argNames)
+		{
+			if (isCppKeyword(argName))
+			{
+				throw Mistake::Bad_Variable_Name("'" + commandName + "' cannot take an argument named '" + argName + "', as C++ keeps the name for itself.", line.row);
+			}
+			if (argName == "result")
+			{
+				throw Mistake::Bad_Variable_Name("'" + commandName + "' cannot take an argument named 'result': it is what the command gives back.", line.row);
 			}
+		}
+	}
+
+	void identifyCommandDeclarations(LexemeLine & line, CommandTable & commands)
+	{
+		// Only a colon makes a declaration: `show ( 1 + 2 )` is a call with its argument in brackets
+		if (line.size() >= 2 && line[0]->isRaw() && line[1]->isSymbol() && static_pointer_cast<Symbol>(line[1])->type == Symbol::COLON)
+		{
+			std::set<std::string> const argNames = commandArgNames(line);
+			int const argCount = static_cast<int>(argNames.size());
 
 			std::string const functionName = static_pointer_cast<RawLexeme>(line[0])->value;
+			checkCommandNames(line, functionName, argNames);
 			Function fn = Function(functionName, functionName, Function::PREFIX, argCount);
 			line[0] = std::make_shared<Function>(fn);
-			commands.push_back(fn);
+			line.type = LexemeLine::COMMAND_DECLARATION;
+			commands.add(fn);
 		}
 	}
 
-	void identifyFunctionUses(LexemeLine & line)
+	// The names the program assigns to, and the variables of its for each loops. A builtin like `max` or `length`
+	// is an ordinary word, so a program that makes a variable of one has that variable from then on, not the builtin
+	void noteVariableNames(LexemeLine const & line, std::set<std::string> & variableNames)
+	{
+		unsigned const start = depthOfLine(line);
+		if (isRawWord(line, start + 1, "=") && line[start]->isRaw()) variableNames.insert(static_pointer_cast<RawLexeme>(line[start])->value);
+		else if (start + 1 < line.size() && line[start]->isKeyword() && line[start + 1]->isVariable()) variableNames.insert(static_pointer_cast<Variable>(line[start + 1])->identifier);
+	}
+
+	void identifyFunctionUses(LexemeLine & line, CommandTable const & commands, std::set<std::string> const & variableNames)
 	{
 		for (PLexeme & lex : line)
 		{
 			if (lex->isRaw())
 			{
 				std::string const name = static_pointer_cast<RawLexeme>(lex)->value;
+				bool const isShadowedBuiltin = variableNames.count(name) > 0 && Vocabulary::functions.find(name);
 				Function fn;
-				if (couldSetFunctionFromName(fn, name)) lex = std::make_shared<Function>(fn);
+				if (!isShadowedBuiltin && couldSetFunctionFromName(fn, name, commands)) lex = std::make_shared<Function>(fn);
+			}
+		}
+	}
+
+	// A command that takes arguments, with nothing after it to be its first, like `show max + 1` where max was never made a variable
+	void checkArgumentsFollow(LexemeLine const & line)
+	{
+		for (unsigned i = 0; i < line.size(); i++)
+		{
+			if (!line[i]->isFunction()) continue;
+			Function const & fn = *static_pointer_cast<Function>(line[i]);
+			if (fn.type != Function::PREFIX || fn.args <= 0) continue;
+
+			bool const nothingFollows = i + 1 == line.size()
+				|| (line[i + 1]->isSymbol() && (static_pointer_cast<Symbol>(line[i + 1])->type == Symbol::CLOSE_BRACKET || static_pointer_cast<Symbol>(line[i + 1])->type == Symbol::ARGS_SEP))
+				|| (line[i + 1]->isFunction() && static_pointer_cast<Function>(line[i + 1])->type == Function::INFIX);
+			if (nothingFollows)
+			{
+				throw Mistake::Missing_Argument("'" + fn.identifier + "' needs " + std::to_string(fn.args) + (fn.args == 1 ? " argument" : " arguments")
+					+ ", but nothing follows it. To use '" + fn.identifier + "' as a variable, assign to it first.", line.row);
 			}
 		}
 	}
@@ -334,7 +386,6 @@ namespace
 			Variable const var = Variable(varName, row, line.depth);
 			
 			line[varIdx] = std::make_shared<Variable>(var);
-			definedVariables.insert(var);
 		}
 	}
 
@@ -349,37 +400,26 @@ namespace
 			}
 		}
 	}
+}
 
-	bool couldIdentifyFunctionInGroups(Function & function, std::string const & name, std::vector<std::vector<Function>> const & groups)
+bool Lexer::couldSetBuiltinFromName(Lexer::Function & fn, std::string const & name)
+{
+	if (Vocabulary::BuiltinFunction const * builtin = Vocabulary::functions.find(name))
 	{
-		for (std::vector<Function> const & group : groups)
-		{
-			for (Function const & fn : group)
-			{
-				if (fn.identifier == name)
-				{
-					function = fn;
-					return true;
-				}
-			}
-		}
-
-		return false;
+		fn = Function(name, std::string(builtin->asCpp), builtin->type, builtin->args, builtin->precedence);
+		return true;
 	}
+	return false;
 }
 
-bool Lexer::couldSetFunctionFromName(Lexer::Function & fn, std::string const & name)
+bool Lexer::couldSetFunctionFromName(Lexer::Function & fn, std::string const & name, CommandTable const & commands)
 {
-	if (couldIdentifyFunctionInGroups(fn, name, opsBeforeCommands)) return true;
-	if (couldIdentifyFunctionInGroups(fn, name, opsAfterCommands)) return true;
+	if (couldSetBuiltinFromName(fn, name)) return true;
 
-	for (Function const & command : commands)
+	if (Function const * command = commands.find(name))
 	{
-		if (command.identifier == name)
-		{
-			fn = command;
-			return true;
-		}
+		fn = *command;
+		return true;
 	}
 
 	return false;
@@ -389,6 +429,8 @@ std::vector<Lexer::LexemeLine> Lexer::createTypedLexemes(std::string const & cod
 {
 	const std::vector<std::vector<std::string>> codeDocument = codeToLines(code);
 	std::vector<LexemeLine> lexemeDoc = docToUntypedLines(codeDocument);
+	CommandTable commands;
+	std::set<std::string> variableNames;
 
 	for (unsigned r = 0; r < lexemeDoc.size(); r++)
 	{
@@ -402,10 +444,14 @@ std::vector<Lexer::LexemeLine> Lexer::createTypedLexemes(std::string const & cod
 		identifyNumbers(line);
 		identifySyntaxSymbols(line);
 
+		identifyForEachLoops(line, r);
 		identifyKeywords(line);
 
-		identifyCommandDeclarations(line, r);
-		identifyFunctionUses(line);
+		joinTwoWordNames(line);
+		identifyCommandDeclarations(line, commands);
+		noteVariableNames(line, variableNames);
+		identifyFunctionUses(line, commands, variableNames);
+		checkArgumentsFollow(line);
 		encloseFunctionsWithBrackets(line);
 
 		identifyVarDefinitions(line, r);
@@ -0,0 +1,173 @@
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Driver.h"
+#include "MappedFile.h"
+#include "Mistake.h"
+#include "Util.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	namespace fs = std::filesystem;
+
+	std::string environment(char const * name)
+	{
+		char const * const value = std::getenv(name);
+		return value ? value : "";
+	}
+
+	std::string quoted(std::string const & path) { return "\"" + path + "\""; }
+
+	bool isSource(std::string const & name) { return fs::path(name).extension() == ".cpp"; }
+
+	long processId()
+	{
+#ifdef _WIN32
+		return static_cast<long>(_getpid());
+#else
+		return static_cast<long>(getpid());
+#endif
+	}
+
+	// What the compiler says its version is, so that a program is built again once the compiler is upgraded
+	std::string compilerVersion(std::string const & compiler)
+	{
+#ifdef _WIN32
+		FILE * const output = _popen((compiler + " --version 2>nul").c_str(), "r");
+#else
+		FILE * const output = popen((compiler + " --version 2>/dev/null").c_str(), "r");
+#endif
+		if (!output) return "";
+
+		std::string version;
+		char buffer[256];
+		while (std::fgets(buffer, sizeof buffer, output)) version += buffer;
+#ifdef _WIN32
+		_pclose(output);
+#else
+		pclose(output);
+#endif
+		return version;
+	}
+
+	// The sources of the runtime, named relative to the program's directory: all of Language, Mistake, which it throws,
+	// MappedFile, which reads files for it, and the compiler's headers, which it includes through Util.h.
+	// Sorted, so they are hashed in the same order whatever order the directories list them in
+	std::vector<std::string> runtimeFiles(std::string const & directory)
+	{
+		std::vector<std::string> files = { "Compiler/MappedFile.cpp", "Compiler/Mistake.cpp" };
+		for (fs::directory_entry const & entry : fs::directory_iterator(directory + "/Language"))
+		{
+			if (entry.is_regular_file()) files.push_back("Language/" + entry.path().filename().string());
+		}
+		for (fs::directory_entry const & entry : fs::directory_iterator(directory + "/Compiler"))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".h") files.push_back("Compiler/" + entry.path().filename().string());
+		}
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+
+	// The length goes in first, so that where one piece ends and the next starts is hashed too
+	std::uint64_t hashPiece(std::uint64_t hash, char const * bytes, std::size_t length)
+	{
+		std::string const size = std::to_string(length) + ":";
+		return Util::fnv1a(bytes, length, Util::fnv1a(size.data(), size.size(), hash));
+	}
+
+	std::uint64_t hashPiece(std::uint64_t hash, std::string const & piece) { return hashPiece(hash, piece.data(), piece.size()); }
+}
+
+Driver::Toolchain::Toolchain() :
+	compiler(environment("CXX").empty() ? "c++" : environment("CXX")),
+	flags(environment("CXXFLAGS").empty() ? "-std=c++17 -O2 -pthread" : "-std=c++17 -O2 -pthread " + environment("CXXFLAGS"))
+{
+#ifdef PTITSA_PARALLEL_ALGORITHMS
+	flags += " -DPTITSA_PARALLEL_ALGORITHMS";
+	libraries = "-ltbb";
+#endif
+}
+
+std::string Driver::cacheDirectory()
+{
+#ifdef _WIN32
+	std::string const localData = environment("LOCALAPPDATA");
+	if (!localData.empty()) return localData + "\\ptitsa";
+#else
+	std::string const cacheHome = environment("XDG_CACHE_HOME");
+	if (!cacheHome.empty()) return cacheHome + "/ptitsa";
+	std::string const home = environment("HOME");
+	if (!home.empty()) return home + "/.cache/ptitsa";
+#endif
+	return (fs::temp_directory_path() / "ptitsa").string();
+}
+
+std::string Driver::cachedExecutable(std::vector<InterpretTree::SourceFile> const & files, std::string const & directory, Toolchain const & toolchain)
+{
+	std::vector<std::string> const runtime = runtimeFiles(directory);
+
+	std::uint64_t hash = hashPiece(Util::fnv1a(toolchain.compiler), compilerVersion(toolchain.compiler));
+	hash = hashPiece(hashPiece(hash, toolchain.flags), toolchain.libraries);
+	for (InterpretTree::SourceFile const & file : files)
+	{
+		hash = hashPiece(hashPiece(hash, file.name), file.code);
+	}
+	for (std::string const & name : runtime)
+	{
+		MappedFile const source(directory + "/" + name);
+		hash = hashPiece(hashPiece(hash, name), source.data(), source.size());
+	}
+
+	fs::path const cache = cacheDirectory();
+	fs::create_directories(cache);
+#ifdef _WIN32
+	std::string const executable = (cache / (Util::toHex(hash) + ".exe")).string();
+#else
+	std::string const executable = (cache / Util::toHex(hash)).string();
+#endif
+	if (fs::exists(executable)) return executable;
+
+	// Built under a name of its own and then renamed, so a run at the same time never finds half an executable.
+	// The process id keeps the names of builds by separate processes apart, and the time those of builds by the same one
+	std::string const building = executable + ".building" + std::to_string(processId()) + "-"
+		+ std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+	std::string command = toolchain.compiler + " " + toolchain.flags + " -o " + quoted(building);
+	for (InterpretTree::SourceFile const & file : files)
+	{
+		if (isSource(file.name)) command += " " + quoted(directory + "/" + file.name);
+	}
+	for (std::string const & name : runtime)
+	{
+		if (isSource(name)) command += " " + quoted(directory + "/" + name);
+	}
+	if (!toolchain.libraries.empty()) command += " " + toolchain.libraries;
+
+	if (std::system(command.c_str()) != 0)
+	{
+		std::error_code ignored;
+		fs::remove(building, ignored);
+		throw Mistake::Could_Not_Build("The C++ compiler could not build the program: " + command);
+	}
+	fs::rename(building, executable);
+	return executable;
+}
+
+int Driver::run(std::string const & executable)
+{
+	int const status = std::system(quoted(executable).c_str());
+#ifdef _WIN32
+	return status;
+#else
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+#endif
+}
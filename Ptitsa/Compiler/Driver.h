@@ -0,0 +1,37 @@
+#ifndef DRIVER_INCLUDE
+#define DRIVER_INCLUDE
+
+#include <string>
+#include <vector>
+
+#include "InterpretTree.h"
+
+// Builds a generated program with the system's C++ compiler and runs it.
+// Built programs are kept in a cache, named by a hash of everything that goes into building them: the generated code,
+// the sources of the runtime, the compiler, its version and its flags. A program already in the cache is not built again
+namespace Driver
+{
+	// The compiler is $CXX, or c++, and its flags are -std=c++17 -O2 -pthread, for the pool of parallel loops, followed by $CXXFLAGS.
+	// When the compiler itself was built with TBB, the runtime's list builtins are built with the parallel algorithms too,
+	// and the libraries link TBB. Libraries go after the sources, so the linker finds what they need
+	struct Toolchain
+	{
+		std::string compiler;
+		std::string flags;
+		std::string libraries;
+
+		Toolchain();
+	};
+
+	// $XDG_CACHE_HOME/ptitsa, or ~/.cache/ptitsa, or %LOCALAPPDATA%\ptitsa on Windows
+	std::string cacheDirectory();
+
+	// The executable for the program whose files were written to `directory`, which holds the runtime in Language and Compiler.
+	// Throws Mistake::Could_Not_Build if the compiler fails
+	std::string cachedExecutable(std::vector<InterpretTree::SourceFile> const & files, std::string const & directory, Toolchain const & toolchain);
+
+	// Runs the executable, and returns its exit code
+	int run(std::string const & executable);
+}
+
+#endif // !DRIVER_INCLUDE
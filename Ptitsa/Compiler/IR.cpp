@@ -0,0 +1,367 @@
+#include <fstream>
+#include <map>
+#include <cstring>
+
+#include "IR.h"
+#include "Mistake.h"
+
+static_assert(sizeof(IR::Header) == 88 && sizeof(IR::Tree) == 12 && sizeof(IR::Node) == 16 && sizeof(IR::Lexeme) == 24 && sizeof(IR::String) == 8,
+	"The layout of .ptic files must not depend on the compiler");
+
+namespace
+{
+	using BuildAST::NodeIndex;
+
+	// Gives each distinct string one index in the string table
+	class StringTable
+	{
+	public:
+		std::uint32_t indexOf(std::string const & text)
+		{
+			auto const found = indexes.find(text);
+			if (found != indexes.end()) return found->second;
+
+			std::uint32_t const index = static_cast<std::uint32_t>(strings.size());
+			strings.push_back({ static_cast<std::uint32_t>(bytes.size()), static_cast<std::uint32_t>(text.size()) });
+			bytes += text;
+			indexes[text] = index;
+			return index;
+		}
+
+		std::vector<IR::String> strings;
+		std::string bytes;
+
+	private:
+		std::map<std::string, std::uint32_t> indexes;
+	};
+
+	IR::Lexeme recordOf(Lexer::PLexeme const & lex, StringTable & table)
+	{
+		using std::static_pointer_cast;
+		IR::Lexeme record = { };
+
+		if (lex->isLiteral())
+		{
+			Lexer::Literal const & literal = *static_pointer_cast<Lexer::Literal>(lex);
+			record.kind = IR::Lexeme::LITERAL;
+			record.type = static_cast<std::uint8_t>(literal.type);
+			record.text = table.indexOf(literal.value);
+		}
+		else if (lex->isVariable())
+		{
+			Lexer::Variable const & variable = *static_pointer_cast<Lexer::Variable>(lex);
+			record.kind = IR::Lexeme::VARIABLE;
+			record.text = table.indexOf(variable.identifier);
+			record.row = variable.row;
+			record.depth = variable.depth;
+		}
+		else if (lex->isFunction())
+		{
+			Lexer::Function const & function = *static_pointer_cast<Lexer::Function>(lex);
+			record.kind = IR::Lexeme::FUNCTION;
+			record.type = static_cast<std::uint8_t>(function.type);
+			record.text = table.indexOf(function.identifier);
+			record.asCpp = table.indexOf(function.asCpp);
+			record.args = function.args;
+			record.precedence = static_cast<std::uint8_t>(function.precedence);
+		}
+		else if (lex->isKeyword())
+		{
+			record.kind = IR::Lexeme::KEYWORD;
+			record.type = static_cast<std::uint8_t>(static_pointer_cast<Lexer::Keyword>(lex)->type);
+		}
+		else if (lex->isSymbol())
+		{
+			record.kind = IR::Lexeme::SYMBOL;
+			record.type = static_cast<std::uint8_t>(static_pointer_cast<Lexer::Symbol>(lex)->type);
+		}
+		else
+		{
+			record.kind = IR::Lexeme::RAW;
+			record.text = table.indexOf(static_pointer_cast<Lexer::RawLexeme>(lex)->value);
+		}
+		return record;
+	}
+
+	void markReachable(BuildAST::Nodes const & nodes, NodeIndex node, std::vector<bool> & reachable)
+	{
+		reachable[node] = true;
+		for (NodeIndex const child : nodes.children(node)) markReachable(nodes, child, reachable);
+	}
+
+	template <typename T> std::uint64_t appendSection(std::string & buffer, std::vector<T> const & records)
+	{
+		buffer.resize((buffer.size() + 7) & ~std::size_t(7), '\0');
+		std::uint64_t const offset = buffer.size();
+		if (!records.empty()) buffer.append(reinterpret_cast<char const *>(records.data()), records.size() * sizeof(T));
+		return offset;
+	}
+
+	// A corrupt file could make a node its own descendant, which would send every pass round forever
+	bool reachesItself(BuildAST::Nodes const & nodes, NodeIndex node, std::vector<std::uint8_t> & state)
+	{
+		enum { UNSEEN, BEING_WALKED, WALKED };
+		if (state[node] == BEING_WALKED) return true;
+		if (state[node] == WALKED) return false;
+
+		state[node] = BEING_WALKED;
+		for (NodeIndex const child : nodes.children(node))
+		{
+			if (reachesItself(nodes, child, state)) return true;
+		}
+		state[node] = WALKED;
+		return false;
+	}
+
+	// What the passes and the emitter take for granted about the tree of each type of line, as write leaves it.
+	// Deferred creations are only made after optimising, so write never sees one
+	bool fitsLineType(BuildAST::Nodes const & nodes, Lexer::LexemeLine::Type type, NodeIndex root)
+	{
+		using Lexer::LexemeLine;
+		bool const assignsVariable = nodes.kind(root) != BuildAST::Node::EMPTY && nodes.childCount(root) == 2
+			&& nodes.kind(nodes.child(root, 0)) == BuildAST::Node::VARIABLE; // `x = value`, or `x in items`
+
+		switch (type)
+		{
+		case LexemeLine::VAR_CREATION:
+		case LexemeLine::VAR_REDEFINITION:
+		case LexemeLine::FOR_EACH:
+		case LexemeLine::PARALLEL_FOR_EACH:
+			return assignsVariable;
+		case LexemeLine::SCOPE_ENTER:
+		case LexemeLine::SCOPE_EXIT:
+			return nodes.isEmpty(root);
+		case LexemeLine::COMMAND_DECLARATION:
+			return nodes.kind(root) == BuildAST::Node::FUNCTION;
+		case LexemeLine::DEFERRED_CREATION:
+			return false;
+		default:
+			return true;
+		}
+	}
+
+	Mistake::Could_Not_Convert notAProgram(std::string const & path, std::string const & reason)
+	{
+		return Mistake::Could_Not_Convert(path + " is not a Ptitsa IR file this compiler can read: " + reason);
+	}
+}
+
+void IR::write(std::string const & path, BuildAST::Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees)
+{
+	std::vector<bool> reachable(nodes.size(), false);
+	for (BuildContextTree::ContextTree const & tree : trees) markReachable(nodes, tree.root, reachable);
+
+	std::vector<std::uint32_t> newIndexes(nodes.size(), 0);
+	std::uint32_t nodeCount = 0;
+	for (NodeIndex node = 0; node < nodes.size(); node++)
+	{
+		if (reachable[node]) newIndexes[node] = nodeCount++;
+	}
+
+	StringTable table;
+	std::map<Lexer::Lexeme const *, std::uint32_t> lexemeIndexes; // lexemes shared between nodes are written once
+	std::vector<Lexeme> lexemes;
+	std::vector<Node> nodeRecords;
+	std::vector<std::uint32_t> children;
+
+	for (NodeIndex node = 0; node < nodes.size(); node++)
+	{
+		if (!reachable[node]) continue;
+
+		Node record = { };
+		record.kind = static_cast<std::uint8_t>(nodes.kind(node));
+		if (!nodes.isEmpty(node))
+		{
+			Lexer::PLexeme const & lex = nodes.lexeme(node);
+			auto const found = lexemeIndexes.find(lex.get());
+			if (found != lexemeIndexes.end()) record.lexeme = found->second;
+			else
+			{
+				record.lexeme = static_cast<std::uint32_t>(lexemes.size());
+				lexemeIndexes[lex.get()] = record.lexeme;
+				lexemes.push_back(recordOf(lex, table));
+			}
+		}
+
+		record.firstChild = static_cast<std::uint32_t>(children.size());
+		record.childCount = nodes.childCount(node);
+		for (NodeIndex const child : nodes.children(node)) children.push_back(newIndexes[child]);
+		nodeRecords.push_back(record);
+	}
+
+	std::vector<Tree> treeRecords;
+	for (BuildContextTree::ContextTree const & tree : trees)
+	{
+		Tree record = { };
+		record.root = newIndexes[tree.root];
+		record.row = tree.row;
+		record.type = static_cast<std::uint8_t>(tree.type);
+		treeRecords.push_back(record);
+	}
+
+	Header header = { };
+	std::memcpy(header.magic, "PTIC", 4);
+	header.version = VERSION;
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.treeCount = static_cast<std::uint32_t>(treeRecords.size());
+	header.nodeCount = nodeCount;
+	header.childCount = static_cast<std::uint32_t>(children.size());
+	header.lexemeCount = static_cast<std::uint32_t>(lexemes.size());
+	header.stringCount = static_cast<std::uint32_t>(table.strings.size());
+	header.stringBytes = static_cast<std::uint32_t>(table.bytes.size());
+
+	std::string buffer(sizeof(Header), '\0');
+	header.treesOffset = appendSection(buffer, treeRecords);
+	header.nodesOffset = appendSection(buffer, nodeRecords);
+	header.childrenOffset = appendSection(buffer, children);
+	header.lexemesOffset = appendSection(buffer, lexemes);
+	header.stringsOffset = appendSection(buffer, table.strings);
+	header.stringBytesOffset = appendSection(buffer, std::vector<char>(table.bytes.begin(), table.bytes.end()));
+	std::memcpy(&buffer[0], &header, sizeof(Header));
+
+	std::ofstream output(path, std::ios::binary);
+	output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	if (!output) throw Mistake::File_Does_Not_Exist("Could not write " + path);
+}
+
+template <typename T> T const * IR::Program::section(std::uint64_t offset, std::uint64_t count) const
+{
+	if (offset % alignof(T) != 0 || offset > file.size() || count > (file.size() - offset) / sizeof(T))
+	{
+		throw notAProgram(path, "a section lies outside the file");
+	}
+	return reinterpret_cast<T const *>(file.data() + offset);
+}
+
+IR::Program::Program(std::string const & path) :
+	file(path),
+	path(path)
+{
+	if (file.size() < sizeof(Header)) throw notAProgram(path, "it is too short");
+
+	Header const & header = this->header();
+	if (std::memcmp(header.magic, "PTIC", 4) != 0) throw notAProgram(path, "it does not start with PTIC");
+	if (header.byteOrder != BYTE_ORDER_MARK) throw notAProgram(path, "it was written on a machine with another byte order");
+	if (header.version != VERSION) throw notAProgram(path, "it is version " + std::to_string(header.version) + ", not " + std::to_string(VERSION));
+
+	section<Tree>(header.treesOffset, header.treeCount);
+	section<Node>(header.nodesOffset, header.nodeCount);
+	section<std::uint32_t>(header.childrenOffset, header.childCount);
+	section<Lexeme>(header.lexemesOffset, header.lexemeCount);
+	section<String>(header.stringsOffset, header.stringCount);
+	section<char>(header.stringBytesOffset, header.stringBytes);
+}
+
+IR::Header const & IR::Program::header() const { return *reinterpret_cast<Header const *>(file.data()); }
+IR::Tree const & IR::Program::tree(std::uint32_t i) const { return reinterpret_cast<Tree const *>(file.data() + header().treesOffset)[i]; }
+IR::Node const & IR::Program::node(std::uint32_t i) const { return reinterpret_cast<Node const *>(file.data() + header().nodesOffset)[i]; }
+IR::Lexeme const & IR::Program::lexeme(std::uint32_t i) const { return reinterpret_cast<Lexeme const *>(file.data() + header().lexemesOffset)[i]; }
+
+std::uint32_t IR::Program::child(Node const & node, std::uint32_t i) const
+{
+	return reinterpret_cast<std::uint32_t const *>(file.data() + header().childrenOffset)[node.firstChild + i];
+}
+
+std::string_view IR::Program::string(std::uint32_t i) const
+{
+	String const & string = reinterpret_cast<String const *>(file.data() + header().stringsOffset)[i];
+	return std::string_view(file.data() + header().stringBytesOffset + string.offset, string.length);
+}
+
+std::vector<BuildContextTree::ContextTree> IR::Program::toContextTrees(BuildAST::Nodes & nodes) const
+{
+	Header const & header = this->header();
+	auto const checkIndex = [this](std::uint64_t index, std::uint64_t count)
+	{
+		if (index >= count) throw notAProgram(path, "an index points outside its section");
+	};
+	auto const text = [&](std::uint32_t i)
+	{
+		checkIndex(i, header.stringCount);
+		String const & string = reinterpret_cast<String const *>(file.data() + header.stringsOffset)[i];
+		checkIndex(std::uint64_t(string.offset) + string.length, std::uint64_t(header.stringBytes) + 1);
+		return std::string(this->string(i));
+	};
+	auto const checkType = [this](std::uint8_t type, int last)
+	{
+		if (type > last) throw notAProgram(path, "a lexeme has a type this compiler does not know");
+	};
+
+	std::vector<Lexer::PLexeme> lexemes;
+	for (std::uint32_t i = 0; i < header.lexemeCount; i++)
+	{
+		Lexeme const & record = lexeme(i);
+		switch (record.kind)
+		{
+		case Lexeme::LITERAL:
+			checkType(record.type, Lexer::Literal::BOOL);
+			lexemes.push_back(std::make_shared<Lexer::Literal>(text(record.text), static_cast<Lexer::Literal::Type>(record.type)));
+			break;
+		case Lexeme::VARIABLE:
+			lexemes.push_back(std::make_shared<Lexer::Variable>(text(record.text), record.row, record.depth));
+			break;
+		case Lexeme::FUNCTION:
+			checkType(record.type, Lexer::Function::UNKNOWN);
+			checkType(record.precedence, Lexer::Function::PRECEDENCES - 1);
+			lexemes.push_back(std::make_shared<Lexer::Function>(text(record.text), text(record.asCpp), static_cast<Lexer::Function::Type>(record.type),
+				record.args, static_cast<Lexer::Function::Precedence>(record.precedence)));
+			break;
+		case Lexeme::KEYWORD:
+			checkType(record.type, Lexer::Keyword::PARALLEL_FOR_EACH);
+			lexemes.push_back(std::make_shared<Lexer::Keyword>(static_cast<Lexer::Keyword::Type>(record.type)));
+			break;
+		case Lexeme::SYMBOL:
+			checkType(record.type, Lexer::Symbol::DEPTH);
+			lexemes.push_back(std::make_shared<Lexer::Symbol>(static_cast<Lexer::Symbol::Type>(record.type)));
+			break;
+		case Lexeme::RAW:
+			lexemes.push_back(std::make_shared<Lexer::RawLexeme>(text(record.text)));
+			break;
+		default:
+			throw notAProgram(path, "a lexeme is of a kind this compiler does not know");
+		}
+	}
+
+	// Nodes are added in the file's order, so node i of the file is `first + i`
+	NodeIndex const first = static_cast<NodeIndex>(nodes.size());
+	for (std::uint32_t i = 0; i < header.nodeCount; i++)
+	{
+		Node const & record = node(i);
+		if (record.kind == BuildAST::Node::EMPTY) nodes.addEmpty();
+		else
+		{
+			checkIndex(record.lexeme, header.lexemeCount);
+			nodes.add(lexemes[record.lexeme]);
+		}
+	}
+	for (std::uint32_t i = 0; i < header.nodeCount; i++)
+	{
+		Node const & record = node(i);
+		checkIndex(std::uint64_t(record.firstChild) + record.childCount, std::uint64_t(header.childCount) + 1);
+
+		std::vector<NodeIndex> children;
+		for (std::uint32_t c = 0; c < record.childCount; c++)
+		{
+			checkIndex(child(record, c), header.nodeCount);
+			children.push_back(first + child(record, c));
+		}
+		BuildAST::Node::Kind const kind = nodes.kind(first + i);
+		bool const isInfix = kind == BuildAST::Node::FUNCTION && nodes.function(first + i).type == Lexer::Function::INFIX;
+		if (isInfix && children.size() != 2) throw notAProgram(path, "an operator does not have two operands");
+		if ((kind == BuildAST::Node::LITERAL || kind == BuildAST::Node::VARIABLE) && !children.empty()) throw notAProgram(path, "a literal or variable has children");
+		nodes.setChildren(first + i, children);
+	}
+
+	std::vector<std::uint8_t> state(nodes.size(), 0);
+	std::vector<BuildContextTree::ContextTree> trees;
+	for (std::uint32_t i = 0; i < header.treeCount; i++)
+	{
+		Tree const & record = tree(i);
+		checkIndex(record.root, header.nodeCount);
+		if (record.type > Lexer::LexemeLine::UNKNOWN) throw notAProgram(path, "a line has a type this compiler does not know");
+		if (reachesItself(nodes, first + record.root, state)) throw notAProgram(path, "a node is its own descendant");
+		if (!fitsLineType(nodes, static_cast<Lexer::LexemeLine::Type>(record.type), first + record.root)) throw notAProgram(path, "a line's tree does not fit its type");
+		trees.push_back(BuildContextTree::ContextTree(static_cast<Lexer::LexemeLine::Type>(record.type), record.row, first + record.root));
+	}
+	return trees;
+}
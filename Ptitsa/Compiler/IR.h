@@ -0,0 +1,101 @@
+#ifndef IR_INCLUDE
+#define IR_INCLUDE
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include "BuildAST.h"
+#include "BuildContextTree.h"
+#include "MappedFile.h"
+
+// The parsed form of a program saved as a .ptic file, so that a program which has not changed does not need lexing and
+// parsing again, and so that other tools can read programs without a lexer of their own.
+// Everything in the file is plain data at fixed offsets: it is mapped into memory and read where it lies.
+// Sections are 8-byte aligned, in the byte order of the machine that wrote the file, which the header records
+
+namespace IR
+{
+	std::uint32_t const VERSION = 2; // 2: lines can be parallel for each loops
+	std::uint32_t const BYTE_ORDER_MARK = 0x01020304;
+
+	struct Header
+	{
+		char magic[4]; // "PTIC"
+		std::uint32_t version;
+		std::uint32_t byteOrder; // BYTE_ORDER_MARK as the writer stored it
+		std::uint32_t treeCount, nodeCount, childCount, lexemeCount, stringCount;
+		std::uint32_t stringBytes;
+		std::uint32_t padding;
+		std::uint64_t treesOffset, nodesOffset, childrenOffset, lexemesOffset, stringsOffset, stringBytesOffset;
+	};
+
+	// One line of the program: a statement, or the opening or closing of a scope
+	struct Tree
+	{
+		std::uint32_t root; // scope lines have an empty root
+		std::uint32_t row;
+		std::uint8_t type; // Lexer::LexemeLine::Type
+		std::uint8_t padding[3];
+	};
+
+	struct Node
+	{
+		std::uint32_t lexeme; // not used by empty nodes
+		std::uint32_t firstChild; // into the list of children
+		std::uint32_t childCount;
+		std::uint8_t kind; // BuildAST::Node::Kind
+		std::uint8_t padding[3];
+	};
+
+	struct Lexeme
+	{
+		enum Kind : std::uint8_t { LITERAL, VARIABLE, FUNCTION, KEYWORD, SYMBOL, RAW };
+
+		std::uint32_t text; // the literal's value, or the variable's, function's or raw lexeme's name
+		std::uint32_t asCpp; // functions only
+		std::uint32_t row, depth; // variables only
+		std::int32_t args; // functions only
+		std::uint8_t kind;
+		std::uint8_t type; // the Type of the literal, function, keyword or symbol
+		std::uint8_t precedence; // functions only
+		std::uint8_t padding;
+	};
+
+	struct String
+	{
+		std::uint32_t offset, length; // into the string bytes
+	};
+
+	// Only the nodes the trees can reach are written, keeping their order
+	void write(std::string const & path, BuildAST::Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees);
+
+	// A .ptic file mapped into memory. Opening it checks the header and that every section lies inside the file.
+	// The sections are read in place, and what is in them is only checked by toContextTrees
+	class Program
+	{
+	public:
+		explicit Program(std::string const & path);
+
+		Header const & header() const;
+		Tree const & tree(std::uint32_t i) const;
+		Node const & node(std::uint32_t i) const;
+		std::uint32_t child(Node const & node, std::uint32_t i) const;
+		Lexeme const & lexeme(std::uint32_t i) const;
+		std::string_view string(std::uint32_t i) const;
+
+		// The trees as the passes and the emitter take them. Lexemes are made again from their records.
+		// Throws if an index, a type or the shape of a tree could not have come from write: a line whose tree does not fit its type,
+		// an operator without two operands, or a literal or variable with children
+		std::vector<BuildContextTree::ContextTree> toContextTrees(BuildAST::Nodes & nodes) const;
+
+	private:
+		MappedFile file;
+		std::string path;
+
+		template <typename T> T const * section(std::uint64_t offset, std::uint64_t count) const;
+	};
+}
+
+#endif // !IR_INCLUDE
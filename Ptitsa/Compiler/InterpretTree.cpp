@@ -1,11 +1,43 @@
 #include "InterpretTree.h"
 #include "BuildContextTree.h"
 #include "BuildAST.h"
+#include "Optimise.h"
+
+#include "Util.h"
 
 #include <string>
+#include <set>
+#include <algorithm>
+#include <thread>
+#include <exception>
 
-namespace 
+namespace
 {
+	using BuildAST::Nodes;
+	using BuildAST::NodeIndex;
+
+	// Phrase literals become constants interned at startup. The name comes from the phrase itself,
+	// so the same literal always maps to the same constant
+	std::string phraseConstantName(std::string const & phrase)
+	{
+		return "ptitsaPhrase_" + Util::toHex(Util::fnv1a(phrase));
+	}
+
+	// Every node is looked at once, in the order it was made, rather than tree by tree
+	std::vector<std::string> collectPhraseLiterals(Nodes const & nodes)
+	{
+		std::vector<std::string> phrases;
+		std::set<std::string> seen;
+		for (NodeIndex node = 0; node < nodes.size(); node++)
+		{
+			if (nodes.kind(node) != BuildAST::Node::LITERAL) continue;
+
+			Lexer::Literal const & lit = nodes.literal(node);
+			if (lit.type == Lexer::Literal::PHRASE && seen.insert(lit.value).second) phrases.push_back(lit.value);
+		}
+		return phrases;
+	}
+
 	std::string lexemeToCpp(Lexer::PLexeme const & lex)
 	{
 		using namespace Lexer;
@@ -20,7 +52,7 @@ namespace
 		{
 			Literal const lit = * static_pointer_cast<Literal>(lex);
 
-			if (lit.type == Literal::PHRASE)	return "std::string(\"" + lit.value + "\")";
+			if (lit.type == Literal::PHRASE)	return phraseConstantName(lit.value);
 			else return lit.value;
 		}
 
@@ -28,7 +60,7 @@ namespace
 		{
 			switch (static_pointer_cast<Symbol>(lex)->type)
 			{
-				case Symbol::Type::ARGS_SEP:	
+				case Symbol::Type::ARGS_SEP:
 					return ",";
 				case Symbol::Type::OPEN_BRACKET:
 					return "(";
@@ -43,23 +75,259 @@ namespace
 
 	}
 
-	std::string functionCallsToString(BuildAST::PASTNode const & node)
+	bool isInfixNamed(Nodes const & nodes, NodeIndex node, std::string const & identifier)
+	{
+		if (nodes.kind(node) != BuildAST::Node::FUNCTION) return false;
+
+		Lexer::Function const & fn = nodes.function(node);
+		return fn.type == Lexer::Function::INFIX && fn.identifier == identifier && nodes.childCount(node) == 2;
+	}
+
+	bool isLiteralOfType(Nodes const & nodes, NodeIndex node, Lexer::Literal::Type type)
+	{
+		return nodes.kind(node) == BuildAST::Node::LITERAL && nodes.literal(node).type == type;
+	}
+
+	// `a + b + c` is built left-nested, as ((a + b) + c). Only the left spine is flattened:
+	// a bracketed right operand keeps its own grouping
+	void collectLeftChain(Nodes const & nodes, NodeIndex node, std::string const & identifier, std::vector<NodeIndex> & operands)
+	{
+		if (isInfixNamed(nodes, node, identifier))
+		{
+			collectLeftChain(nodes, nodes.child(node, 0), identifier, operands);
+			operands.push_back(nodes.child(node, 1));
+		}
+		else operands.push_back(node);
+	}
+
+	// A chain of at least three parts with a phrase literal and no number or boolean literals is joined in one call
+	bool isPhraseChain(Nodes const & nodes, std::vector<NodeIndex> const & operands)
+	{
+		if (operands.size() < 3) return false;
+
+		bool phraseSeen = false;
+		for (NodeIndex const operand : operands)
+		{
+			if (isLiteralOfType(nodes, operand, Lexer::Literal::PHRASE)) phraseSeen = true;
+			else if (isLiteralOfType(nodes, operand, Lexer::Literal::NUMBER) || isLiteralOfType(nodes, operand, Lexer::Literal::BOOL)) return false;
+		}
+		return phraseSeen;
+	}
+
+	bool isArithmetic(Nodes const & nodes, NodeIndex node)
+	{
+		for (std::string const identifier : { "+", "-", "*", "/", "^" })
+		{
+			if (isInfixNamed(nodes, node, identifier)) return true;
+		}
+		return false;
+	}
+
+	bool hasNonNumericLiteral(Nodes const & nodes, NodeIndex node)
+	{
+		if (isLiteralOfType(nodes, node, Lexer::Literal::PHRASE) || isLiteralOfType(nodes, node, Lexer::Literal::BOOL)) return true;
+
+		for (NodeIndex const child : nodes.children(node))
+		{
+			if (hasNonNumericLiteral(nodes, child)) return true;
+		}
+		return false;
+	}
+
+	// Worth evaluating lazily once there is at least one intermediate result, e.g. `a * b + c`
+	bool isLazyArithmetic(Nodes const & nodes, NodeIndex node)
+	{
+		return isArithmetic(nodes, node)
+			&& (isArithmetic(nodes, nodes.child(node, 0)) || isArithmetic(nodes, nodes.child(node, 1)))
+			&& !hasNonNumericLiteral(nodes, node);
+	}
+
+	unsigned const minimumAlternatives = 4; // with fewer, comparing one by one is as quick
+
+	// Reading it again gives the same value and does nothing else, so it can be tested once instead
+	bool isPureSubject(Nodes const & nodes, NodeIndex node)
+	{
+		switch (nodes.kind(node))
+		{
+		case BuildAST::Node::LITERAL:
+		case BuildAST::Node::VARIABLE:
+			return true;
+
+		case BuildAST::Node::FUNCTION:
+		{
+			if (!Optimise::isPure(nodes.function(node))) return false;
+
+			for (NodeIndex const child : nodes.children(node))
+			{
+				if (!isPureSubject(nodes, child)) return false;
+			}
+			return true;
+		}
+
+		default:
+			return false;
+		}
+	}
+
+	bool isTestAgainstLiteral(Nodes const & nodes, NodeIndex node, std::string const & comparison)
+	{
+		return isInfixNamed(nodes, node, comparison) && nodes.kind(nodes.child(node, 1)) == BuildAST::Node::LITERAL && isPureSubject(nodes, nodes.child(node, 0));
+	}
+
+	// `x is a or b or c ...` reads as `x is a or x is b or x is c ...` by the time it gets here, and `x isnt a or b ...`
+	// as `x isnt a and x isnt b ...`. A run of enough of these, on the same subject and against literals, is tested
+	// in one go against a table made before the program starts. Anything else in the chain is left where it was,
+	// so it is worked out in the same order and only when it would have been
+	struct AlternativesRun
+	{
+		unsigned first, end; // operands [first, end) of the chain
+		std::string tableName, tableInitialiser;
+	};
+
+	std::vector<AlternativesRun> findAlternativesRuns(Nodes const & nodes, std::vector<NodeIndex> const & operands, std::string const & comparison)
+	{
+		std::vector<AlternativesRun> runs;
+		unsigned i = 0;
+		while (i < operands.size())
+		{
+			if (!isTestAgainstLiteral(nodes, operands[i], comparison))
+			{
+				i++;
+				continue;
+			}
+
+			std::string const subject = Optimise::structureOf(nodes, nodes.child(operands[i], 0));
+			unsigned end = i + 1;
+			while (end < operands.size() && isTestAgainstLiteral(nodes, operands[end], comparison) && Optimise::structureOf(nodes, nodes.child(operands[end], 0)) == subject) end++;
+
+			if (end - i >= minimumAlternatives)
+			{
+				AlternativesRun run = { i, end, "", "{ " };
+				for (unsigned j = i; j < end; j++)
+				{
+					run.tableInitialiser += lexemeToCpp(nodes.lexeme(nodes.child(operands[j], 1)));
+					run.tableInitialiser += j + 1 < end ? ", " : " }";
+				}
+				run.tableName = "ptitsaAlternatives_" + Util::toHex(Util::fnv1a(run.tableInitialiser));
+				runs.push_back(run);
+			}
+			i = end;
+		}
+		return runs;
+	}
+
+	// The comparison a chain joined by `connective` could be testing alternatives with, if any
+	bool couldSetAlternativesComparison(Nodes const & nodes, NodeIndex node, std::string & connective, std::string & comparison)
+	{
+		for (std::string const chainConnective : { "or", "and" })
+		{
+			if (isInfixNamed(nodes, node, chainConnective))
+			{
+				connective = chainConnective;
+				comparison = chainConnective == "or" ? "is" : "isnt";
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void collectAlternativesTables(Nodes const & nodes, NodeIndex node, std::vector<AlternativesRun> & tables, std::set<std::string> & seen)
+	{
+		std::string connective, comparison;
+		if (!couldSetAlternativesComparison(nodes, node, connective, comparison))
+		{
+			for (NodeIndex const child : nodes.children(node)) collectAlternativesTables(nodes, child, tables, seen);
+			return;
+		}
+
+		std::vector<NodeIndex> operands;
+		collectLeftChain(nodes, node, connective, operands);
+		for (AlternativesRun const & run : findAlternativesRuns(nodes, operands, comparison))
+		{
+			if (seen.insert(run.tableName).second) tables.push_back(run);
+		}
+		for (NodeIndex const operand : operands) collectAlternativesTables(nodes, operand, tables, seen);
+	}
+
+	std::string functionCallsToString(Nodes const & nodes, NodeIndex node);
+
+	// Every operator is bracketed, so the emitted grouping is the AST's and not C++'s precedence of `^`
+	std::string lazyArithmeticToString(Nodes const & nodes, NodeIndex node)
+	{
+		if (isArithmetic(nodes, node))
+		{
+			std::string const op = nodes.function(node).asCpp;
+			return "(" + lazyArithmeticToString(nodes, nodes.child(node, 0)) + " " + op + " " + lazyArithmeticToString(nodes, nodes.child(node, 1)) + ")";
+		}
+		return "BuiltinType::lazy(" + functionCallsToString(nodes, node) + ")";
+	}
+
+	std::string functionCallsToString(Nodes const & nodes, NodeIndex node)
 	{
 		using namespace Lexer;
-		std::string const nodeAsString = lexemeToCpp(node->lex);
+		std::string const nodeAsString = lexemeToCpp(nodes.lexeme(node));
 
-		if (node->children.empty()) return nodeAsString;
-		else if (node->lex->isFunction())
+		if (nodes.childCount(node) == 0)
 		{
+			bool const isCall = nodes.kind(node) == BuildAST::Node::FUNCTION && nodes.function(node).type == Function::PREFIX;
+			return isCall ? nodeAsString + "()" : nodeAsString;
+		}
+		else if (nodes.kind(node) == BuildAST::Node::FUNCTION)
+		{
+			if (isInfixNamed(nodes, node, "+"))
+			{
+				std::vector<NodeIndex> operands;
+				collectLeftChain(nodes, node, "+", operands);
+
+				if (isPhraseChain(nodes, operands))
+				{
+					std::string concatenation = "Library::concatenate(";
+					for (unsigned i = 0; i < operands.size(); i++)
+					{
+						concatenation += functionCallsToString(nodes, operands[i]);
+						concatenation += i + 1 < operands.size() ? ", " : ")";
+					}
+					return concatenation;
+				}
+			}
+
+			std::string connective, comparison;
+			if (couldSetAlternativesComparison(nodes, node, connective, comparison))
+			{
+				std::vector<NodeIndex> operands;
+				collectLeftChain(nodes, node, connective, operands);
+				std::vector<AlternativesRun> const runs = findAlternativesRuns(nodes, operands, comparison);
+
+				if (!runs.empty())
+				{
+					std::string chain;
+					unsigned nextRun = 0;
+					for (unsigned i = 0; i < operands.size(); )
+					{
+						if (!chain.empty()) chain += connective == "or" ? " || " : " && ";
+						if (nextRun < runs.size() && runs[nextRun].first == i)
+						{
+							if (comparison == "isnt") chain += "!";
+							chain += runs[nextRun].tableName + ".contains(" + functionCallsToString(nodes, nodes.child(operands[i], 0)) + ")";
+							i = runs[nextRun++].end;
+						}
+						else chain += functionCallsToString(nodes, operands[i++]);
+					}
+					return chain;
+				}
+			}
+
+			if (isLazyArithmetic(nodes, node)) return "BuiltinType::Object" + lazyArithmeticToString(nodes, node);
+
 			std::string fnCallAsString;
 			std::vector<std::string> argNames;
 
-			for (BuildAST::PASTNode const & arg : node->children)
+			for (NodeIndex const arg : nodes.children(node))
 			{
-				argNames.push_back(functionCallsToString(arg));
+				argNames.push_back(functionCallsToString(nodes, arg));
 			}
 
-			Function const fn = *std::static_pointer_cast<Function>(node->lex);
+			Function const & fn = nodes.function(node);
 
 			if (fn.type == Function::PREFIX)
 			{
@@ -71,6 +339,10 @@ namespace
 					else fnCallAsString += ")";
 				}
 			}
+			else if (fn.type == Function::INFIX && fn.asCpp.find("::") != std::string::npos) // a word like `to`, which the runtime does as a call
+			{
+				fnCallAsString = fn.asCpp + "(" + argNames[0] + ", " + argNames[1] + ")";
+			}
 			else if (fn.type == Function::INFIX)
 			{
 				fnCallAsString = argNames[0] + " " + fn.asCpp + " " + argNames[1];
@@ -85,7 +357,48 @@ namespace
 
 	}
 
-	std::string treeToString(BuildContextTree::ContextTree const & tree)
+	bool isVariableNamed(Nodes const & nodes, NodeIndex node, std::string const & identifier)
+	{
+		return nodes.kind(node) == BuildAST::Node::VARIABLE && nodes.variable(node).identifier == identifier;
+	}
+
+	bool mentionsVariable(Nodes const & nodes, NodeIndex node, std::string const & identifier)
+	{
+		if (isVariableNamed(nodes, node, identifier)) return true;
+
+		for (NodeIndex const child : nodes.children(node))
+		{
+			if (mentionsVariable(nodes, child, identifier)) return true;
+		}
+		return false;
+	}
+
+	// `x = x + y + ...` grows x in place rather than copying it into a new Object every time
+	bool couldSetSelfUpdate(Nodes const & nodes, NodeIndex root, std::string & selfUpdate)
+	{
+		if (!isInfixNamed(nodes, root, "=") || nodes.kind(nodes.child(root, 0)) != BuildAST::Node::VARIABLE) return false;
+
+		std::string const identifier = nodes.variable(nodes.child(root, 0)).identifier;
+		std::vector<NodeIndex> operands;
+		collectLeftChain(nodes, nodes.child(root, 1), "+", operands);
+
+		if (operands.size() < 2 || !isVariableNamed(nodes, operands[0], identifier)) return false;
+
+		for (unsigned i = 1; i < operands.size(); i++) // x would already have changed by the time it is read again
+		{
+			if (mentionsVariable(nodes, operands[i], identifier)) return false;
+		}
+
+		selfUpdate = "Library::addInPlace(" + identifier;
+		for (unsigned i = 1; i < operands.size(); i++)
+		{
+			selfUpdate += ", " + functionCallsToString(nodes, operands[i]);
+		}
+		selfUpdate += ")";
+		return true;
+	}
+
+	std::string treeToString(Nodes const & nodes, BuildContextTree::ContextTree const & tree)
 	{
 		using Lexer::LexemeLine;
 		std::string const varType = "BuiltinType::Object";
@@ -93,16 +406,26 @@ namespace
 		switch (tree.type)
 		{
 		case LexemeLine::VAR_CREATION:
-			return "BuiltinType::Object " + functionCallsToString(tree.root) + ";";
+			return "BuiltinType::Object " + functionCallsToString(nodes, tree.root) + ";";
 
 		case LexemeLine::VAR_REDEFINITION:
-			return functionCallsToString(tree.root) + ";";
+		{
+			std::string selfUpdate;
+			if (couldSetSelfUpdate(nodes, tree.root, selfUpdate)) return selfUpdate + ";";
+			return functionCallsToString(nodes, tree.root) + ";";
+		}
 
 		case LexemeLine::IF:
-			return "if (Library::isTrue(" + functionCallsToString(tree.root) + "))";
+			return "if (Library::isTrue(" + functionCallsToString(nodes, tree.root) + "))";
 
 		case LexemeLine::WHILE:
-			return "while (Library::isTrue(" + functionCallsToString(tree.root) + "))";
+			return "while (Library::isTrue(" + functionCallsToString(nodes, tree.root) + "))";
+
+		case LexemeLine::DEFERRED_CREATION:
+		{
+			std::string const name = nodes.variable(tree.root).identifier;
+			return "BuiltinType::Deferred " + name + "([&] { return BuiltinType::Object(" + functionCallsToString(nodes, nodes.child(tree.root, 0)) + "); });";
+		}
 
 		case LexemeLine::SCOPE_ENTER:
 			return "{";
@@ -111,30 +434,570 @@ namespace
 			return "}";
 
 		default:
-			return functionCallsToString(tree.root) + ";";
+			return functionCallsToString(nodes, tree.root) + ";";
 		}
 	}
-}
 
-std::string InterpretTree::treesToString(std::vector<BuildContextTree::ContextTree> const & trees)
-{
-	std::string cppCode = R"(
-#include "Language\Object.h"
-#include "Language\Core.h"
+	std::string quoted(std::string const & text)
+	{
+		std::string result = "\"";
+		for (char const c : text)
+		{
+			if (c == '\\' || c == '"') result += '\\';
+			result += c;
+		}
+		return result + "\"";
+	}
 
-int main()
-{
+	// Whether the body of the for each loop whose line is statements[k] assigns to the loop's variable. Only then are items put back into the list
+	bool loopChangesItems(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, std::vector<unsigned> const & statements, std::size_t k)
+	{
+		using Lexer::LexemeLine;
+		std::string const variable = functionCallsToString(nodes, nodes.child(trees[statements[k]].root, 0));
+		if (k + 1 >= statements.size() || trees[statements[k + 1]].type != LexemeLine::SCOPE_ENTER) return false;
+
+		for (std::size_t b = k + 1, bodyDepth = 0; b < statements.size(); b++)
+		{
+			BuildContextTree::ContextTree const & line = trees[statements[b]];
+			if (line.type == LexemeLine::SCOPE_ENTER) bodyDepth++;
+			else if (line.type == LexemeLine::SCOPE_EXIT && --bodyDepth == 0) break;
+			else if (line.type == LexemeLine::VAR_REDEFINITION && isVariableNamed(nodes, nodes.child(line.root, 0), variable)) return true;
+		}
+		return false;
+	}
+
+	// A for each loop's line depends on its body: the items are only put back when the body assigns to the loop's variable.
+	// The body of a parallel loop is a lambda, so its line opens a call, and the line closing its body closes the call.
+	// Gives the statements rendered differently for that, and an empty string for the others
+	std::vector<std::string> loopLines(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, std::vector<unsigned> const & statements)
+	{
+		using Lexer::LexemeLine;
+		std::vector<std::string> lines(statements.size());
+		std::vector<unsigned> loopBodyDepths; // depths at which the bodies of parallel loops end
+		unsigned depth = 0;
+
+		for (std::size_t k = 0; k < statements.size(); k++)
+		{
+			BuildContextTree::ContextTree const & tree = trees[statements[k]];
+			if (tree.type == LexemeLine::SCOPE_ENTER)
+			{
+				bool const isLoopBody = k > 0 && trees[statements[k - 1]].type == LexemeLine::PARALLEL_FOR_EACH;
+				if (isLoopBody) loopBodyDepths.push_back(depth);
+				depth++;
+			}
+			else if (tree.type == LexemeLine::SCOPE_EXIT)
+			{
+				depth--;
+				if (!loopBodyDepths.empty() && loopBodyDepths.back() == depth)
+				{
+					lines[k] = "});";
+					loopBodyDepths.pop_back();
+				}
+			}
+			else if (tree.type == LexemeLine::FOR_EACH) // in(x, items)
+			{
+				std::string const variable = "for (BuiltinType::Object & " + functionCallsToString(nodes, nodes.child(tree.root, 0));
+				NodeIndex const items = nodes.child(tree.root, 1);
+
+				bool const readsLines = nodes.kind(items) == BuildAST::Node::FUNCTION && nodes.function(items).identifier == "read lines" && nodes.childCount(items) == 1;
+				if (readsLines) lines[k] = variable + " : Library::EachLine(" + functionCallsToString(nodes, nodes.child(items, 0)) + "))"; // streamed, rather than read into a list first
+				else lines[k] = variable + " : Library::Each(" + functionCallsToString(nodes, items) + ", " + (loopChangesItems(nodes, trees, statements, k) ? "true" : "false") + "))";
+			}
+			else if (tree.type == LexemeLine::PARALLEL_FOR_EACH) // in(x, items)
+			{
+				bool const hasBody = k + 1 < statements.size() && trees[statements[k + 1]].type == LexemeLine::SCOPE_ENTER;
+				bool const changesItems = loopChangesItems(nodes, trees, statements, k); // only then are the items copied, to be put back once the loop is done
+
+				lines[k] = "Library::forEachInParallel(" + functionCallsToString(nodes, nodes.child(tree.root, 1)) + ", " + (changesItems ? "true" : "false")
+					+ ", [&](BuiltinType::Object & " + functionCallsToString(nodes, nodes.child(tree.root, 0)) + ")" + (hasBody ? "" : " { });");
+			}
+		}
+		return lines;
+	}
+
+	// A statement is timed from just before it to just after it, and what it does to memory is put down to it from its start
+	// to the end of its scope. An if or loop is timed and tracked with its whole body, so its probe and line are made in a scope
+	// around it, which is closed once its body has been
+	std::string instrumentedTreeToString(std::vector<BuildContextTree::ContextTree> const & trees, unsigned idx, std::string const & statement,
+		InterpretTree::Options const & options, bool & opensInstrumentedScope)
+	{
+		using Lexer::LexemeLine;
+		BuildContextTree::ContextTree const & tree = trees[idx];
+
+		bool const hasBody = idx + 1 < trees.size() && trees[idx + 1].type == LexemeLine::SCOPE_ENTER;
+		bool const isHeader = tree.type == LexemeLine::IF || tree.type == LexemeLine::WHILE || tree.type == LexemeLine::FOR_EACH || tree.type == LexemeLine::PARALLEL_FOR_EACH;
+		opensInstrumentedScope = false;
+		if (tree.row == 0 || (isHeader && !hasBody)) return statement + "\n";
+
+		std::string const row = std::to_string(tree.row);
+		std::string const probe = "ptitsaProbe" + std::to_string(idx);
+		std::string start;
+		if (options.profile) start += "Library::Profiler::Probe " + probe + "(" + row + ");\n";
+		if (options.trackMemory) start += "Library::Memory::Line ptitsaLine" + std::to_string(idx) + "(" + row + ");\n";
+		if (options.profile) start += "#line " + row + " " + quoted(options.sourceName) + "\n";
+
+		if (isHeader)
+		{
+			opensInstrumentedScope = true;
+			return "{ " + start + statement + "\n";
+		}
+		return start + statement + "\n" + (options.profile ? probe + ".stop();\n" : "");
+	}
 
+	// Fewer statements than this to a thread and starting the thread costs more than rendering them
+	std::size_t const statementsPerThread = 512;
+
+	unsigned threadsFor(InterpretTree::Options const & options)
+	{
+		if (options.threads != 0) return options.threads;
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Splits [0, count) into contiguous chunks, one per thread, and calls work(chunk, begin, end) for each.
+	// Rendering a statement reads the trees and writes nothing shared, so the chunks need no locking
+	template <typename Work> std::size_t forEachChunk(std::size_t count, unsigned threads, Work const & work)
+	{
+		std::size_t const chunks = std::max<std::size_t>(1, std::min<std::size_t>(threads, count / statementsPerThread));
+		auto const start = [count, chunks](std::size_t chunk) { return count * chunk / chunks; };
+
+		std::vector<std::exception_ptr> failures(chunks);
+		auto const runChunk = [&](std::size_t chunk)
+		{
+			try { work(chunk, start(chunk), start(chunk + 1)); }
+			catch (...) { failures[chunk] = std::current_exception(); }
+		};
+
+		std::vector<std::thread> workers;
+		for (std::size_t chunk = 1; chunk < chunks; chunk++) workers.emplace_back(runChunk, chunk);
+		runChunk(0);
+		for (std::thread & worker : workers) worker.join();
+
+		for (std::exception_ptr const & failure : failures)
+		{
+			if (failure) std::rethrow_exception(failure); // the earliest, as rendering one after another would have found
+		}
+		return chunks;
+	}
+
+	// Each chunk of statements is rendered into a buffer of its own, and the buffers are joined in order,
+	// so the code is the same whatever the number of threads
+	std::string statementsToString(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, std::vector<unsigned> const & statements, InterpretTree::Options const & options)
+	{
+		std::vector<std::string> const loops = loopLines(nodes, trees, statements);
+		auto const statementToString = [&](std::size_t k)
+		{
+			return loops[k].empty() ? treeToString(nodes, trees[statements[k]]) : loops[k];
+		};
+
+		std::string cppCode;
+		if (!options.profile && !options.trackMemory)
+		{
+			std::vector<std::string> buffers(threadsFor(options));
+			std::size_t const chunks = forEachChunk(statements.size(), threadsFor(options), [&](std::size_t chunk, std::size_t begin, std::size_t end)
+			{
+				for (std::size_t k = begin; k < end; k++) buffers[chunk] += statementToString(k) + "\n";
+			});
+
+			std::size_t length = 0;
+			for (std::size_t chunk = 0; chunk < chunks; chunk++) length += buffers[chunk].size();
+			cppCode.reserve(length);
+			for (std::size_t chunk = 0; chunk < chunks; chunk++) cppCode += buffers[chunk];
+			return cppCode;
+		}
+
+		// Where the scopes of instrumented ifs and loops close depends on the statements before, so only the statements are rendered in parallel
+		std::vector<std::string> rendered(statements.size());
+		std::vector<char> opensInstrumentedScope(statements.size(), false);
+		forEachChunk(statements.size(), threadsFor(options), [&](std::size_t, std::size_t begin, std::size_t end)
+		{
+			for (std::size_t k = begin; k < end; k++)
+			{
+				bool opens;
+				rendered[k] = instrumentedTreeToString(trees, statements[k], statementToString(k), options, opens);
+				opensInstrumentedScope[k] = opens;
+			}
+		});
+
+		std::vector<unsigned> instrumentedScopeDepths; // depths at which the bodies of instrumented ifs and loops end
+		unsigned depth = 0;
+		for (std::size_t k = 0; k < statements.size(); k++)
+		{
+			unsigned const i = statements[k];
+			cppCode += rendered[k];
+			if (opensInstrumentedScope[k]) instrumentedScopeDepths.push_back(depth);
+
+			if (trees[i].type == Lexer::LexemeLine::SCOPE_ENTER) depth++;
+			else if (trees[i].type == Lexer::LexemeLine::SCOPE_EXIT)
+			{
+				depth--;
+				if (!instrumentedScopeDepths.empty() && instrumentedScopeDepths.back() == depth)
+				{
+					cppCode += "}\n";
+					instrumentedScopeDepths.pop_back();
+				}
+			}
+		}
+		return cppCode;
+	}
+
+	// A command declared by the program: the line declaring it, and the indented body below, from its opening to its closing scope line
+	struct CommandDefinition
+	{
+		unsigned declarationIdx, bodyStart, bodyEnd;
+	};
+
+	std::vector<CommandDefinition> findCommandDefinitions(std::vector<BuildContextTree::ContextTree> const & trees)
+	{
+		using Lexer::LexemeLine;
+		std::vector<CommandDefinition> definitions;
+
+		for (unsigned i = 0; i < trees.size(); i++)
+		{
+			if (trees[i].type != LexemeLine::COMMAND_DECLARATION) continue;
+
+			CommandDefinition definition = { i, i + 1, i + 1 };
+			if (definition.bodyStart < trees.size() && trees[definition.bodyStart].type == LexemeLine::SCOPE_ENTER)
+			{
+				unsigned depth = 0;
+				do
+				{
+					if (trees[definition.bodyEnd].type == LexemeLine::SCOPE_ENTER) depth++;
+					else if (trees[definition.bodyEnd].type == LexemeLine::SCOPE_EXIT) depth--;
+					definition.bodyEnd++;
+				} while (depth > 0 && definition.bodyEnd < trees.size());
+			}
+			definitions.push_back(definition);
+			i = definition.bodyEnd - 1;
+		}
+		return definitions;
+	}
+
+	void collectVariableNames(Nodes const & nodes, NodeIndex node, std::vector<std::string> & names)
+	{
+		if (nodes.kind(node) == BuildAST::Node::VARIABLE)
+		{
+			std::string const & identifier = nodes.variable(node).identifier;
+			if (std::find(names.begin(), names.end(), identifier) == names.end()) names.push_back(identifier);
+		}
+		for (NodeIndex const child : nodes.children(node)) collectVariableNames(nodes, child, names);
+	}
+
+	bool bodyReassigns(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, CommandDefinition const & definition, std::string const & identifier)
+	{
+		for (unsigned i = definition.bodyStart; i < definition.bodyEnd; i++)
+		{
+			if (trees[i].type == Lexer::LexemeLine::VAR_REDEFINITION && isVariableNamed(nodes, nodes.child(trees[i].root, 0), identifier)) return true;
+		}
+		return false;
+	}
+
+	// Arguments are taken by const reference, so calling a command copies nothing,
+	// unless the body assigns to one, in which case it gets its own copy to change.
+	// Short commands are marked inline, unless the program is split, when each is defined in one file and only declared in the others
+	std::string commandSignature(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, CommandDefinition const & definition, bool mayBeInline)
+	{
+		unsigned const inlineStatementLimit = 8;
+		NodeIndex const declaration = trees[definition.declarationIdx].root;
+
+		std::vector<std::string> arguments;
+		for (NodeIndex const child : nodes.children(declaration)) collectVariableNames(nodes, child, arguments);
+
+		unsigned statements = 0;
+		for (unsigned i = definition.bodyStart; i < definition.bodyEnd; i++)
+		{
+			if (trees[i].type != Lexer::LexemeLine::SCOPE_ENTER && trees[i].type != Lexer::LexemeLine::SCOPE_EXIT) statements++;
+		}
+
+		std::string signature = mayBeInline && statements <= inlineStatementLimit ? "inline " : "";
+		signature += "BuiltinType::Object " + nodes.function(declaration).asCpp + "(";
+		for (unsigned i = 0; i < arguments.size(); i++)
+		{
+			signature += bodyReassigns(nodes, trees, definition, arguments[i]) ? "BuiltinType::Object " : "BuiltinType::Object const & ";
+			signature += arguments[i];
+			if (i + 1 < arguments.size()) signature += ", ";
+		}
+		return signature + ")";
+	}
+
+	std::string commandToString(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, CommandDefinition const & definition,
+		InterpretTree::Options const & options, bool mayBeInline)
+	{
+		std::vector<unsigned> body;
+		for (unsigned i = definition.bodyStart; i < definition.bodyEnd; i++) body.push_back(i);
+
+		return "\n" + commandSignature(nodes, trees, definition, mayBeInline) + "\n{\nBuiltinType::Object result;\n"
+			+ statementsToString(nodes, trees, body, options)
+			+ "return result;\n}\n";
+	}
+
+	std::string includesFor(std::vector<BuildContextTree::ContextTree> const & trees, InterpretTree::Options const & options)
+	{
+		using InterpretTree::Options;
+		std::string cppCode = R"(
+#include "Language/Object.h"
+#include "Language/Core.h"
+#include "Language/Expression.h"
 )";
+		if (options.arena != Options::NO_ARENA) cppCode += "#include \"Language/Arena.h\"\n";
+		if (options.profile) cppCode += "#include \"Language/Profiler.h\"\n";
+		if (options.trackMemory) cppCode += "#ifndef PTITSA_TRACK_MEMORY\n#error \"Compiled with --track-memory: build the program and the runtime with PTITSA_TRACK_MEMORY defined\"\n#endif\n"
+			"#include \"Language/Memory.h\"\n";
+		bool const hasDeferred = std::any_of(trees.begin(), trees.end(), [](BuildContextTree::ContextTree const & tree)
+		{
+			return tree.type == Lexer::LexemeLine::DEFERRED_CREATION;
+		});
+		if (hasDeferred) cppCode += "#include \"Language/Deferred.h\"\n";
+		bool const hasParallelLoop = std::any_of(trees.begin(), trees.end(), [](BuildContextTree::ContextTree const & tree)
+		{
+			return tree.type == Lexer::LexemeLine::PARALLEL_FOR_EACH;
+		});
+		if (hasParallelLoop) cppCode += "#include \"Language/Parallel.h\"\n";
+		return cppCode + "\n";
+	}
 
-	for (BuildContextTree::ContextTree const & tree : trees)
+	// The constants for the phrases and alternatives, as definitions, or as declarations for the files which only use them
+	std::string constantsToString(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, bool declarationsOnly)
 	{
-		cppCode += treeToString(tree) + "\n";
+		std::string cppCode;
+		for (std::string const & phrase : collectPhraseLiterals(nodes))
+		{
+			if (declarationsOnly) cppCode += "extern BuiltinType::Object const " + phraseConstantName(phrase) + ";\n";
+			else cppCode += "BuiltinType::Object const " + phraseConstantName(phrase) + " = BuiltinType::intern(\"" + phrase + "\");\n";
+		}
+
+		std::vector<AlternativesRun> alternativesTables;
+		std::set<std::string> seenTables;
+		for (BuildContextTree::ContextTree const & tree : trees)
+		{
+			collectAlternativesTables(nodes, tree.root, alternativesTables, seenTables);
+		}
+		for (AlternativesRun const & table : alternativesTables)
+		{
+			if (declarationsOnly) cppCode += "extern Library::Alternatives const " + table.tableName + ";\n";
+			else cppCode += "Library::Alternatives const " + table.tableName + "(" + table.tableInitialiser + ");\n";
+		}
+		return cppCode;
 	}
-	cppCode += R"(
+
+	std::string mainStart(InterpretTree::Options const & options)
+	{
+		using InterpretTree::Options;
+		std::string cppCode = R"(
+int main()
+{
+
+)";
+		if (options.profile) cppCode += "Library::Profiler::start(" + quoted(options.sourceName) + ");\n";
+		switch (options.arena)
+		{
+			case Options::NO_ARENA:			break;
+			case Options::POOL_ARENA:		cppCode += "Library::Arena arena(Library::Arena::POOL);\n";		break;
+			case Options::MONOTONIC_ARENA:	cppCode += "Library::Arena arena(Library::Arena::MONOTONIC);\n";	break;
+		}
+		if (options.trackMemory) cppCode += "Library::Memory::start(" + quoted(options.sourceName) + ");\n"; // after the arena, so it counts what is allocated from it
+		return cppCode;
+	}
+
+	std::string const mainEnd = R"(
 
 	return 0;
 }
 )";
-	return cppCode;
-}
\ No newline at end of file
+
+	std::vector<unsigned> statementsOutsideCommands(std::vector<BuildContextTree::ContextTree> const & trees, std::vector<CommandDefinition> const & definitions)
+	{
+		std::vector<bool> isInCommand(trees.size(), false);
+		for (CommandDefinition const & definition : definitions)
+		{
+			for (unsigned i = definition.declarationIdx; i < definition.bodyEnd; i++) isInCommand[i] = true;
+		}
+
+		std::vector<unsigned> statements;
+		for (unsigned i = 0; i < trees.size(); i++)
+		{
+			if (!isInCommand[i]) statements.push_back(i);
+		}
+		return statements;
+	}
+
+	// A split program's top level is cut into functions of about this many statements at most
+	std::size_t const statementsPerPart = 256;
+
+	void collectDeferredReads(Nodes const & nodes, NodeIndex node, std::vector<std::string> & names)
+	{
+		if (nodes.kind(node) == BuildAST::Node::VARIABLE && nodes.variable(node).identifier[0] == '*') names.push_back(nodes.variable(node).identifier.substr(1));
+		for (NodeIndex const child : nodes.children(node)) collectDeferredReads(nodes, child, names);
+	}
+
+	// The top level is only cut between lines outside any scope, and never before the opening of a scope, which belongs
+	// to the if or while above it. A deferred value is read through a reference to it, so no cut falls between a deferred line and its last read
+	std::vector<std::vector<unsigned>> cutIntoParts(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees,
+		std::vector<unsigned> const & statements, unsigned files)
+	{
+		using Lexer::LexemeLine;
+		std::size_t const partSize = std::max<std::size_t>(1, std::min(statementsPerPart, (statements.size() + files - 1) / files));
+
+		std::map<std::string, std::size_t> lastRead;
+		for (std::size_t k = 0; k < statements.size(); k++)
+		{
+			std::vector<std::string> names;
+			collectDeferredReads(nodes, trees[statements[k]].root, names);
+			for (std::string const & name : names) lastRead[name] = k;
+		}
+
+		std::vector<std::vector<unsigned>> parts(1);
+		unsigned depth = 0;
+		std::size_t deferredReadUntil = 0;
+		for (std::size_t k = 0; k < statements.size(); k++)
+		{
+			BuildContextTree::ContextTree const & tree = trees[statements[k]];
+			bool const canCut = depth == 0 && tree.type != LexemeLine::SCOPE_ENTER && k > deferredReadUntil;
+			if (canCut && parts.back().size() >= partSize) parts.emplace_back();
+			parts.back().push_back(statements[k]);
+
+			if (tree.type == LexemeLine::SCOPE_ENTER) depth++;
+			else if (tree.type == LexemeLine::SCOPE_EXIT) depth--;
+			else if (tree.type == LexemeLine::DEFERRED_CREATION)
+			{
+				auto const found = lastRead.find(nodes.variable(tree.root).identifier);
+				if (found != lastRead.end()) deferredReadUntil = std::max(deferredReadUntil, found->second);
+			}
+		}
+		return parts;
+	}
+
+	// The variables made outside any scope at the top level, which every part shares, in the order they are made
+	std::vector<std::string> findStateVariables(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, std::vector<unsigned> const & statements)
+	{
+		using Lexer::LexemeLine;
+		std::vector<std::string> variables;
+		unsigned depth = 0;
+		for (unsigned const i : statements)
+		{
+			if (trees[i].type == LexemeLine::SCOPE_ENTER) depth++;
+			else if (trees[i].type == LexemeLine::SCOPE_EXIT) depth--;
+			else if (depth == 0 && trees[i].type == LexemeLine::VAR_CREATION)
+			{
+				std::string const & identifier = nodes.variable(nodes.child(trees[i].root, 0)).identifier;
+				if (std::find(variables.begin(), variables.end(), identifier) == variables.end()) variables.push_back(identifier);
+			}
+		}
+		return variables;
+	}
+
+	std::string partName(std::size_t part) { return "ptitsaPart" + std::to_string(part); }
+
+	// A part reaches the shared variables it uses through references named as they are, so its statements are rendered as usual
+	std::string partToString(Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, std::vector<unsigned> const & part,
+		std::size_t index, std::set<std::string> const & stateVariables, InterpretTree::Options const & options)
+	{
+		std::vector<std::string> used;
+		for (unsigned const i : part) collectVariableNames(nodes, trees[i].root, used);
+
+		std::string cppCode = "\nvoid " + partName(index) + "(ProgramState & state)\n{\n";
+		for (std::string const & variable : used)
+		{
+			if (stateVariables.count(variable)) cppCode += "BuiltinType::Object & " + variable + " = state." + variable + ";\n";
+		}
+		return cppCode + statementsToString(nodes, trees, part, options) + "}\n";
+	}
+}
+
+InterpretTree::Options::Options() :
+	arena(NO_ARENA),
+	profile(false),
+	trackMemory(false),
+	sourceName("program.pti"),
+	threads(0)
+{ }
+
+std::string InterpretTree::treesToString(BuildAST::Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees)
+{
+	return treesToString(nodes, trees, Options());
+}
+
+std::string InterpretTree::treesToString(BuildAST::Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, Options const & options)
+{
+	std::string cppCode = includesFor(trees, options) + constantsToString(nodes, trees, false);
+
+	std::vector<CommandDefinition> const definitions = findCommandDefinitions(trees);
+	if (!definitions.empty()) cppCode += "\n";
+	for (CommandDefinition const & definition : definitions) cppCode += commandSignature(nodes, trees, definition, true) + ";\n";
+	for (CommandDefinition const & definition : definitions) cppCode += commandToString(nodes, trees, definition, options, true);
+
+	cppCode += mainStart(options);
+	cppCode += statementsToString(nodes, trees, statementsOutsideCommands(trees, definitions), options);
+	return cppCode + mainEnd;
+}
+
+std::vector<InterpretTree::SourceFile> InterpretTree::treesToFiles(BuildAST::Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees,
+	Options const & options, unsigned files)
+{
+	files = std::max(files, 1u);
+	std::vector<CommandDefinition> const definitions = findCommandDefinitions(trees);
+	std::vector<unsigned> const statements = statementsOutsideCommands(trees, definitions);
+	std::vector<std::vector<unsigned>> const parts = cutIntoParts(nodes, trees, statements, files);
+	std::vector<std::string> const stateVariables = findStateVariables(nodes, trees, statements);
+
+	// A variable shared by the parts is made along with the state, so the line that made it only assigns to it
+	std::vector<BuildContextTree::ContextTree> splitTrees = trees;
+	unsigned depth = 0;
+	for (unsigned const i : statements)
+	{
+		if (splitTrees[i].type == Lexer::LexemeLine::SCOPE_ENTER) depth++;
+		else if (splitTrees[i].type == Lexer::LexemeLine::SCOPE_EXIT) depth--;
+		else if (depth == 0 && splitTrees[i].type == Lexer::LexemeLine::VAR_CREATION) splitTrees[i].type = Lexer::LexemeLine::VAR_REDEFINITION;
+	}
+
+	std::string header = "#ifndef PTITSA_PROGRAM_INCLUDE\n#define PTITSA_PROGRAM_INCLUDE\n" + includesFor(trees, options) + constantsToString(nodes, trees, true);
+	if (!definitions.empty()) header += "\n";
+	for (CommandDefinition const & definition : definitions) header += commandSignature(nodes, trees, definition, false) + ";\n";
+	header += "\n// The variables of the top level of the program, which all its parts share\nstruct ProgramState\n{\n";
+	for (std::string const & variable : stateVariables) header += "BuiltinType::Object " + variable + ";\n";
+	header += "};\n\n";
+	for (std::size_t part = 0; part < parts.size(); part++) header += "void " + partName(part) + "(ProgramState & state);\n";
+	header += "\n#endif // !PTITSA_PROGRAM_INCLUDE\n";
+
+	std::string mainFile = "#include \"program.h\"\n\n" + constantsToString(nodes, trees, false) + mainStart(options) + "ProgramState state;\n";
+	for (std::size_t part = 0; part < parts.size(); part++) mainFile += partName(part) + "(state);\n";
+	mainFile += mainEnd;
+
+	// Each command and part goes to the file with the fewest statements so far, keeping the files about the same size
+	std::vector<std::string> codes(files, "#include \"program.h\"\n");
+	std::vector<std::size_t> sizes(files, 0);
+	auto const smallest = [&sizes]() { return std::min_element(sizes.begin(), sizes.end()) - sizes.begin(); };
+	for (CommandDefinition const & definition : definitions)
+	{
+		std::size_t const file = smallest();
+		codes[file] += commandToString(nodes, trees, definition, options, false);
+		sizes[file] += definition.bodyEnd - definition.declarationIdx;
+	}
+	std::set<std::string> const shared(stateVariables.begin(), stateVariables.end());
+	for (std::size_t part = 0; part < parts.size(); part++)
+	{
+		std::size_t const file = smallest();
+		codes[file] += partToString(nodes, splitTrees, parts[part], part, shared, options);
+		sizes[file] += parts[part].size();
+	}
+
+	std::vector<SourceFile> sourceFiles = { { "program.h", header }, { "program.cpp", mainFile } };
+	std::string fragment = "# Made by the Ptitsa compiler with the files it lists. include() it, then build PTITSA_PROGRAM_SOURCES with the runtime in Language,\n"
+		"# with the definitions in PTITSA_PROGRAM_DEFINITIONS, linking PTITSA_PROGRAM_LIBRARIES\n"
+		"set(PTITSA_PROGRAM_SOURCES\n\t${CMAKE_CURRENT_LIST_DIR}/program.cpp\n";
+	for (unsigned file = 0; file < files; file++)
+	{
+		std::string const name = "program_" + std::to_string(file + 1) + ".cpp";
+		sourceFiles.push_back({ name, codes[file] });
+		fragment += "\t${CMAKE_CURRENT_LIST_DIR}/" + name + "\n";
+	}
+	fragment += ")\n";
+	fragment += std::string("set(PTITSA_PROGRAM_DEFINITIONS") + (options.trackMemory ? " PTITSA_TRACK_MEMORY" : "") + ")\nset(PTITSA_PROGRAM_LIBRARIES)\n";
+	fragment += "# The runtime's list builtins use the parallel algorithms where TBB is there to run them\n"
+		"find_package(TBB QUIET)\n"
+		"if (TBB_FOUND)\n"
+		"\tlist(APPEND PTITSA_PROGRAM_DEFINITIONS PTITSA_PARALLEL_ALGORITHMS)\n"
+		"\tlist(APPEND PTITSA_PROGRAM_LIBRARIES TBB::tbb)\n"
+		"endif()\n";
+	sourceFiles.push_back({ "program.cmake", fragment });
+	return sourceFiles;
+}
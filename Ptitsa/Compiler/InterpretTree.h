@@ -10,7 +10,31 @@
 
 namespace InterpretTree
 {
-	std::string treesToString(std::vector<BuildContextTree::ContextTree> const & trees);
+	struct Options
+	{
+		enum Arena { NO_ARENA, POOL_ARENA, MONOTONIC_ARENA } arena;
+		bool profile; // time every statement, and point compiler messages back to lines of the source
+		bool trackMemory; // count the Objects and bytes of every statement. The program has to be built with PTITSA_TRACK_MEMORY
+		std::string sourceName;
+		unsigned threads; // rendering long programs, or 0 for one per hardware thread
+
+		Options();
+	};
+
+	// A generated file, named relative to the directory of the program
+	struct SourceFile
+	{
+		std::string name;
+		std::string code;
+	};
+
+	std::string treesToString(BuildAST::Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees);
+	std::string treesToString(BuildAST::Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, Options const & options);
+
+	// The program split so that no file or function of it is large: the top level is cut into functions sharing its variables
+	// through a ProgramState, which are spread with the commands over `files` files. With them come program.h,
+	// program.cpp holding main, and program.cmake listing the .cpp files so they can be built in parallel
+	std::vector<SourceFile> treesToFiles(BuildAST::Nodes const & nodes, std::vector<BuildContextTree::ContextTree> const & trees, Options const & options, unsigned files);
 }
 
 #endif // !INTERPRET_TREE_INCLUDE
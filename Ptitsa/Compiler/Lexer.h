@@ -33,8 +33,7 @@ namespace Lexer
 
 	struct Keyword : Lexeme
 	{
-		enum Type { IF, FOR_EACH, WHILE } type;
-		static std::map<std::string, Type> const valuesToKeywordTypes;
+		enum Type { IF, FOR_EACH, WHILE, PARALLEL_FOR_EACH } type;
 		static std::map<Type, std::string> const typeToCpp;
 
 		bool isKeyword() override;
@@ -57,6 +56,7 @@ namespace Lexer
 	struct Function : Lexeme
 	{
 		enum Type { PREFIX, INFIX, POSTFIX, UNKNOWN } type;
+		enum Precedence { POWER, PRODUCT, SUM, COMMAND, COMPARISON, AND, OR, ASSIGNMENT, PRECEDENCES } precedence; // functions with lower precedence are worked out first
 		unsigned order;
 		bool processed;
 		int args; // value of -1 means takes any amount of args
@@ -66,8 +66,10 @@ namespace Lexer
 		Function();
 		Function(std::string const & identifier, std::string const & asCpp, Type type);
 		Function(std::string const & identifier, std::string const & asCpp, Type type, int args);
+		Function(std::string const & identifier, std::string const & asCpp, Type type, int args, Precedence precedence);
 		Function(std::string const & identifier, std::string const & asCpp);
 		Function(Function const & other);
+		Function & operator=(Function const & other) = default;
 
 		bool operator==(Function const & other) const;
 		bool operator<(Function const & other) const;
@@ -97,7 +99,6 @@ namespace Lexer
 	{
 		enum Type { OPEN_BRACKET, CLOSE_BRACKET, ARGS_SEP, COLON, DEPTH } type;
 		bool processed;
-		static std::map<std::string, Symbol::Type> const idsToSymbols;
 		bool isSymbol() override;
 
 		Symbol(Type);
@@ -107,8 +108,9 @@ namespace Lexer
 
 	struct LexemeLine
 	{
-		enum Type { VAR_CREATION, VAR_REDEFINITION, IF, WHILE, FOR_EACH, VOID_FUNCTION_CALL, SCOPE_ENTER, SCOPE_EXIT, UNKNOWN } type;
+		enum Type { VAR_CREATION, VAR_REDEFINITION, IF, WHILE, FOR_EACH, PARALLEL_FOR_EACH, VOID_FUNCTION_CALL, COMMAND_DECLARATION, DEFERRED_CREATION, SCOPE_ENTER, SCOPE_EXIT, UNKNOWN } type;
 		unsigned depth;
+		unsigned row; // line in the source, counting from 1. 0 for lines the compiler made, like SCOPE_ENTER
 
 		 LexemeLine(std::vector<PLexeme> const &);
 		 LexemeLine(Type);
@@ -144,10 +146,26 @@ namespace Lexer
 	std::ostream & operator<<(std::ostream &, PLexeme const &);
 	std::ostream & operator<<(std::ostream &, LexemeLine const &);
 
-	extern std::vector<std::vector<Function>> const opsBeforeCommands, opsAfterCommands;
-	extern std::vector<Function> commands;
+	// The commands declared by the program being compiled. Open addressing, so finding one is usually a single probe.
+	// Each compile has its own, so programs compiled at the same time never see each other's commands
+	class CommandTable
+	{
+	public:
+		CommandTable();
+
+		void add(Function const &);
+		Function const * find(std::string const & identifier) const;
+
+	private:
+		std::vector<Function> slots;
+		std::vector<bool> used;
+		unsigned count;
+
+		unsigned slotFor(std::string const & identifier) const;
+	};
 
-	bool couldSetFunctionFromName(Function &, std::string const &);
+	bool couldSetBuiltinFromName(Function &, std::string const &);
+	bool couldSetFunctionFromName(Function &, std::string const &, CommandTable const &); // a builtin, or else one of the commands
 
 	std::vector<LexemeLine> createTypedLexemes(std::string const &);	
 	void parseTypedLexemes(std::vector<LexemeLine> &);
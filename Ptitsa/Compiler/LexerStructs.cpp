@@ -4,6 +4,7 @@
 #include <iostream>
 
 #include "Lexer.h"
+#include "Util.h"
 
 // Lexeme
 bool Lexer::Lexeme::isFunction() { return false; }
@@ -27,12 +28,6 @@ Lexer::Keyword::Keyword(Lexer::Keyword::Type type):
 
 bool Lexer::Keyword::isKeyword() { return true; }
 
-std::map<std::string, Lexer::Keyword::Type> const Lexer::Keyword::valuesToKeywordTypes = {
-	{"if", Lexer::Keyword::IF },
-	{"foreach", Lexer::Keyword::FOR_EACH},
-	{"while", Lexer::Keyword::WHILE}
-};
-
 // Literal
 Lexer::Literal::Literal(std::string const & value, Lexer::Literal::Type type):
 	value(value),
@@ -44,6 +39,7 @@ Lexer::Literal::Literal(std::string const & value, Lexer::Literal::Type type):
 // Function
 Lexer::Function::Function() :
 	type(UNKNOWN),
+	precedence(COMMAND),
 	processed(false),
 	args(0),
 	identifier(),
@@ -55,6 +51,7 @@ Lexer::Function::Function(std::string const & identifier, std::string const & as
 	identifier(identifier),
 	asCpp(asCpp),
 	type(type),
+	precedence(COMMAND),
 	processed(false),
 	order(0)
 {
@@ -66,6 +63,7 @@ Lexer::Function::Function(std::string const & identifier, std::string const & as
 	identifier(identifier),
 	asCpp(asCpp),
 	type(POSTFIX),
+	precedence(COMMAND),
 	processed(false),
 	args(0),
 	order(0)
@@ -75,6 +73,17 @@ Lexer::Function::Function(std::string const & identifier, std::string const & as
 	identifier(identifier),
 	asCpp(asCpp),
 	type(type),
+	precedence(COMMAND),
+	args(args),
+	processed(false),
+	order(0)
+{ }
+
+Lexer::Function::Function(std::string const & identifier, std::string const & asCpp, Lexer::Function::Type type, int args, Lexer::Function::Precedence precedence) :
+	identifier(identifier),
+	asCpp(asCpp),
+	type(type),
+	precedence(precedence),
 	args(args),
 	processed(false),
 	order(0)
@@ -84,6 +93,7 @@ Lexer::Function::Function(Lexer::Function const & copy):
 	identifier(copy.identifier),
 	asCpp(copy.asCpp),
 	type(copy.type),
+	precedence(copy.precedence),
 	args(copy.args),
 	order(copy.order),
 	processed(copy.processed)
@@ -142,32 +152,28 @@ Lexer::Symbol::Symbol(Lexer::Symbol::Type type):
 	processed(false)
 { }
 
-std::map<std::string, Lexer::Symbol::Type> const Lexer::Symbol::idsToSymbols = {
-	{ "(", Symbol::OPEN_BRACKET },
-	{ ")", Symbol::CLOSE_BRACKET },
-	{ ",", Symbol::ARGS_SEP },
-	{ ":", Symbol::COLON }
-};
-
 bool Lexer::Symbol::isSymbol() { return true; }
 
 // LexemeLine
 Lexer::LexemeLine::LexemeLine(std::vector<Lexer::PLexeme> const & lexemes) :
 	lexemes(lexemes),
 	type(UNKNOWN),
-	depth(0)
+	depth(0),
+	row(0)
 { }
 
 Lexer::LexemeLine::LexemeLine(LexemeLine::Type type):
 	lexemes(),
 	type(type),
-	depth(0)
+	depth(0),
+	row(0)
 { }
 
 Lexer::LexemeLine::LexemeLine():
 	lexemes(),
 	type(UNKNOWN),
-	depth(0)
+	depth(0),
+	row(0)
 { }
 
 Lexer::PLexeme& Lexer::LexemeLine::operator[](unsigned i) { return lexemes[i]; }
@@ -232,6 +238,7 @@ std::ostream& Lexer::operator<<(std::ostream & ostream, Lexer::PKeyword const &
 	switch (lex->type)
 	{
 		case Keyword::FOR_EACH:		ostream << "for each";	break;
+		case Keyword::PARALLEL_FOR_EACH:	ostream << "for each parallel";	break;
 		case Keyword::IF:			ostream << "if";		break;
 		case Keyword::WHILE:		ostream << "while";		break;
 		default:					ostream << "unknown";	break;
@@ -294,6 +301,7 @@ std::ostream& Lexer::operator<<(std::ostream & ostream, Lexer::LexemeLine const
 	switch (line.type)
 	{
 		case LexemeLine::Type::FOR_EACH:			ostream << "for";		break;
+		case LexemeLine::Type::PARALLEL_FOR_EACH:	ostream << "parallel for";	break;
 		case LexemeLine::Type::IF:					ostream << "if";		break;
 		case LexemeLine::Type::WHILE:				ostream << "while";		break;
 		case LexemeLine::Type::SCOPE_ENTER:			ostream << ">>";		break;
@@ -301,6 +309,8 @@ std::ostream& Lexer::operator<<(std::ostream & ostream, Lexer::LexemeLine const
 		case LexemeLine::Type::VAR_CREATION:		ostream << "new var";	break;
 		case LexemeLine::Type::VAR_REDEFINITION:	ostream << "redef var";	break;
 		case LexemeLine::Type::VOID_FUNCTION_CALL:	ostream << "fn call";	break;
+		case LexemeLine::Type::COMMAND_DECLARATION:	ostream << "command";	break;
+		case LexemeLine::Type::DEFERRED_CREATION:	ostream << "deferred";	break;
 		case LexemeLine::Type::UNKNOWN:				ostream << "?";			break;
 	}
 	ostream << " } ";
@@ -311,4 +321,52 @@ std::ostream& Lexer::operator<<(std::ostream & ostream, Lexer::LexemeLine const
 	}
 	ostream << "\n";
 	return ostream;
-}
\ No newline at end of file
+}
+
+// CommandTable
+Lexer::CommandTable::CommandTable() :
+	slots(),
+	used(),
+	count(0)
+{ }
+
+unsigned Lexer::CommandTable::slotFor(std::string const & identifier) const
+{
+	unsigned const mask = slots.size() - 1;
+	unsigned slot = Util::fnv1a(identifier) & mask;
+	while (used[slot] && slots[slot].identifier != identifier) slot = (slot + 1) & mask;
+	return slot;
+}
+
+void Lexer::CommandTable::add(Lexer::Function const & command)
+{
+	if (2 * (count + 1) > slots.size()) // keep at most half full, so probes stay short
+	{
+		unsigned const newSize = slots.empty() ? 16 : 2 * slots.size();
+		std::vector<Function> oldSlots(newSize);
+		std::vector<bool> oldUsed(newSize, false);
+		oldSlots.swap(slots);
+		oldUsed.swap(used);
+
+		for (unsigned i = 0; i < oldSlots.size(); i++)
+		{
+			if (!oldUsed[i]) continue;
+			unsigned const slot = slotFor(oldSlots[i].identifier);
+			slots[slot] = oldSlots[i];
+			used[slot] = true;
+		}
+	}
+
+	unsigned const slot = slotFor(command.identifier);
+	if (!used[slot]) count++;
+	slots[slot] = command;
+	used[slot] = true;
+}
+
+Lexer::Function const * Lexer::CommandTable::find(std::string const & identifier) const
+{
+	if (slots.empty()) return nullptr;
+
+	unsigned const slot = slotFor(identifier);
+	return used[slot] ? &slots[slot] : nullptr;
+}
@@ -0,0 +1,104 @@
+#include "MappedFile.h"
+#include "Mistake.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(std::string const & path) :
+	bytes(nullptr),
+	length(0),
+	file(INVALID_HANDLE_VALUE),
+	mapping(nullptr)
+{
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) throw Mistake::File_Does_Not_Exist("Could not open " + path);
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	length = static_cast<std::size_t>(fileSize.QuadPart);
+	if (length == 0) return; // an empty file cannot be mapped, and has nothing to read anyway
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping) bytes = static_cast<char const *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!bytes)
+	{
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		throw Mistake::File_Does_Not_Exist("Could not read " + path);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (bytes) UnmapViewOfFile(bytes);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+void MappedFile::willReadInOrder() const { }
+void MappedFile::doneBefore(std::size_t) const { }
+
+#else
+
+MappedFile::MappedFile(std::string const & path) :
+	bytes(nullptr),
+	length(0)
+{
+	int const descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0) throw Mistake::File_Does_Not_Exist("Could not open " + path);
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0)
+	{
+		close(descriptor);
+		throw Mistake::File_Does_Not_Exist("Could not read " + path);
+	}
+	length = static_cast<std::size_t>(status.st_size);
+
+	if (length > 0) // an empty file cannot be mapped, and has nothing to read anyway
+	{
+		void * const mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (mapped == MAP_FAILED)
+		{
+			close(descriptor);
+			throw Mistake::File_Does_Not_Exist("Could not read " + path);
+		}
+		bytes = static_cast<char const *>(mapped);
+	}
+	close(descriptor); // the mapping keeps the file open
+}
+
+MappedFile::~MappedFile()
+{
+	if (bytes) munmap(const_cast<char *>(bytes), length);
+}
+
+void MappedFile::willReadInOrder() const
+{
+	if (bytes) madvise(const_cast<char *>(bytes), length, MADV_SEQUENTIAL);
+}
+
+// The mapping is private and never written, so dropped pages are read again from the file if they are ever touched
+void MappedFile::doneBefore(std::size_t offset) const
+{
+	std::size_t const page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	std::size_t const whole = std::min(offset, length) / page * page;
+	if (bytes && whole > 0) madvise(const_cast<char *>(bytes), whole, MADV_DONTNEED);
+}
+
+#endif
+
+char const * MappedFile::data() const { return bytes; }
+std::size_t MappedFile::size() const { return length; }
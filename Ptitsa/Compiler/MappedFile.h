@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_INCLUDE
+#define MAPPED_FILE_INCLUDE
+
+#include <string>
+#include <cstddef>
+
+// A whole file mapped read-only into memory, so reading it is reading memory: nothing is copied in,
+// and pages the reader never touches are never loaded. Unmapped when destroyed
+class MappedFile
+{
+public:
+	explicit MappedFile(std::string const & path);
+	MappedFile(MappedFile const &) = delete;
+	MappedFile & operator=(MappedFile const &) = delete;
+	~MappedFile();
+
+	char const * data() const;
+	std::size_t size() const;
+
+	// For a reader going through the file once from start to end: pages are read ahead of it,
+	// and doneBefore gives back the pages before an offset it has finished with, so its memory stays bounded.
+	// Only hints, so they do nothing where the system has no way to take them
+	void willReadInOrder() const;
+	void doneBefore(std::size_t offset) const;
+
+private:
+	char const * bytes;
+	std::size_t length;
+#ifdef _WIN32
+	void * file;
+	void * mapping;
+#endif
+};
+
+#endif // !MAPPED_FILE_INCLUDE
@@ -32,6 +32,12 @@ namespace Mistake
 	class File_Does_Not_Exist:		public BaiscException { using BaiscException::BaiscException; };
 
 	class Could_Not_Convert:		public BaiscException { using BaiscException::BaiscException; };
+
+	class Could_Not_Build:			public BaiscException { using BaiscException::BaiscException; };
+
+	class Not_Safe_In_Parallel:		public BaiscException { using BaiscException::BaiscException; };
+
+	class Missing_Argument:			public BaiscException { using BaiscException::BaiscException; };
 }
 
 #endif
@@ -0,0 +1,357 @@
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <string_view>
+#include <algorithm>
+
+#include "Optimise.h"
+#include "BuildAST.h"
+
+namespace
+{
+	using Lexer::LexemeLine;
+	using BuildContextTree::ContextTree;
+	using BuildAST::Nodes;
+	using BuildAST::NodeIndex;
+
+	constexpr std::string_view pureCommands[] = { "not", "exp", "length", "sum", "max", "sort", "contains", "reverse" };
+
+	// Index just past the SCOPE_EXIT that closes the scope opened at scopeEnterIdx
+	unsigned scopeEndOf(std::vector<ContextTree> const & trees, unsigned scopeEnterIdx)
+	{
+		unsigned depth = 0;
+		unsigned i = scopeEnterIdx;
+		do
+		{
+			if (trees[i].type == LexemeLine::SCOPE_ENTER) depth++;
+			else if (trees[i].type == LexemeLine::SCOPE_EXIT) depth--;
+			i++;
+		} while (depth > 0 && i < trees.size());
+		return i;
+	}
+
+	bool isForEach(LexemeLine::Type type) { return type == LexemeLine::FOR_EACH || type == LexemeLine::PARALLEL_FOR_EACH; }
+
+	// A for each loop's line assigns each item to its variable in turn
+	bool assignedVariable(Nodes const & nodes, ContextTree const & tree, std::string & identifier)
+	{
+		if (tree.type != LexemeLine::VAR_CREATION && tree.type != LexemeLine::VAR_REDEFINITION && !isForEach(tree.type)) return false;
+
+		NodeIndex const assignee = nodes.child(tree.root, 0);
+		if (nodes.kind(assignee) != BuildAST::Node::VARIABLE) return false;
+
+		identifier = nodes.variable(assignee).identifier;
+		return true;
+	}
+
+	// A for each loop whose body assigns to its variable puts what it assigns back into the list it goes over, in(x, items),
+	// so changes that list when the list is a variable
+	bool assignedItems(Nodes const & nodes, std::vector<ContextTree> const & trees, unsigned loop, std::string & identifier)
+	{
+		std::string variable;
+		if (!isForEach(trees[loop].type) || !assignedVariable(nodes, trees[loop], variable)) return false;
+		if (loop + 1 >= trees.size() || trees[loop + 1].type != LexemeLine::SCOPE_ENTER) return false;
+
+		NodeIndex const items = nodes.child(trees[loop].root, 1);
+		if (nodes.kind(items) != BuildAST::Node::VARIABLE) return false;
+
+		unsigned const bodyEnd = scopeEndOf(trees, loop + 1);
+		for (unsigned i = loop + 2; i < bodyEnd; i++)
+		{
+			std::string assigned;
+			if (trees[i].type == LexemeLine::VAR_REDEFINITION && assignedVariable(nodes, trees[i], assigned) && assigned == variable)
+			{
+				identifier = nodes.variable(items).identifier;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Whether the subtree only gives back a value, collecting the variables it reads.
+	// Literals alone are not worth keeping, as arithmetic on them is already cheap:
+	// only subtrees that read a variable or call a command are
+	bool isPureExpression(Nodes const & nodes, NodeIndex node, std::set<std::string> & variables, bool & worthKeeping)
+	{
+		switch (nodes.kind(node))
+		{
+		case BuildAST::Node::LITERAL:
+			return true;
+
+		case BuildAST::Node::VARIABLE:
+			worthKeeping = true;
+			variables.insert(nodes.variable(node).identifier);
+			return true;
+
+		case BuildAST::Node::FUNCTION:
+		{
+			Lexer::Function const & fn = nodes.function(node);
+			if (!Optimise::isPure(fn)) return false;
+			if (fn.type == Lexer::Function::PREFIX) worthKeeping = true;
+
+			for (NodeIndex const child : nodes.children(node))
+			{
+				if (!isPureExpression(nodes, child, variables, worthKeeping)) return false;
+			}
+			return true;
+		}
+
+		default:
+			return false;
+		}
+	}
+
+	unsigned sizeOf(Nodes const & nodes, NodeIndex node)
+	{
+		unsigned size = 1;
+		for (NodeIndex const child : nodes.children(node)) size += sizeOf(nodes, child);
+		return size;
+	}
+
+	void replaceWithReadOf(Nodes & nodes, NodeIndex node, std::string const & name)
+	{
+		nodes.replace(node, nodes.add(std::make_shared<Lexer::Variable>("*" + name)));
+	}
+
+	// The subtree at `node` moves under a node naming it, and is read in its old place through `*name`
+	NodeIndex takeIntoDeferred(Nodes & nodes, NodeIndex node, std::string const & name)
+	{
+		NodeIndex const deferred = nodes.add(std::make_shared<Lexer::Variable>(name), { nodes.moveToNew(node) });
+		replaceWithReadOf(nodes, node, name);
+		return deferred;
+	}
+
+	// The largest invariant subtrees are moved into `hoisted`. The same subtree found twice in the loop is hoisted once
+	void hoistFrom(Nodes & nodes, NodeIndex node, std::set<std::string> const & assigned, std::map<std::string, std::string> & namesByStructure,
+		std::vector<NodeIndex> & hoisted, Optimise::Statistics & statistics)
+	{
+		if (nodes.kind(node) != BuildAST::Node::FUNCTION) return;
+
+		std::set<std::string> variables;
+		bool worthKeeping = false;
+		bool const isInvariant = isPureExpression(nodes, node, variables, worthKeeping)
+			&& std::none_of(variables.begin(), variables.end(), [&](std::string const & variable) { return assigned.count(variable); });
+
+		if (isInvariant && worthKeeping)
+		{
+			std::string const structure = Optimise::structureOf(nodes, node);
+			auto const found = namesByStructure.find(structure);
+			if (found != namesByStructure.end())
+			{
+				replaceWithReadOf(nodes, node, found->second);
+				return;
+			}
+
+			std::string const name = "ptitsaInvariant" + std::to_string(statistics.hoistedInvariants++);
+			namesByStructure[structure] = name;
+			hoisted.push_back(takeIntoDeferred(nodes, node, name));
+			return;
+		}
+
+		for (NodeIndex const child : nodes.children(node))
+		{
+			hoistFrom(nodes, child, assigned, namesByStructure, hoisted, statistics);
+		}
+	}
+
+	// A run of statements with no scope lines or loops between them, so each is run once, straight after the one before.
+	// An if's condition is part of the run before its body.
+	// Deferred lines are skipped, as what they hold is worked out wherever it is first read
+	bool isStraightLine(LexemeLine::Type type)
+	{
+		switch (type)
+		{
+			case LexemeLine::VAR_CREATION:
+			case LexemeLine::VAR_REDEFINITION:
+			case LexemeLine::VOID_FUNCTION_CALL:
+			case LexemeLine::IF:
+			case LexemeLine::UNKNOWN:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	struct Occurrence
+	{
+		NodeIndex node;
+		unsigned treeIdx;
+	};
+
+	void collectOccurrences(Nodes const & nodes, NodeIndex node, unsigned treeIdx,
+		std::map<std::string, unsigned> const & variableVersions, std::unordered_map<std::string, std::vector<Occurrence>> & occurrences)
+	{
+		if (nodes.isEmpty(node)) return;
+
+		std::set<std::string> variables;
+		bool worthKeeping = false;
+		if (nodes.kind(node) == BuildAST::Node::FUNCTION && isPureExpression(nodes, node, variables, worthKeeping) && worthKeeping)
+		{
+			// the same structure only counts as the same value while the variables it reads keep their version
+			std::string key = Optimise::structureOf(nodes, node) + "@";
+			for (std::string const & variable : variables)
+			{
+				auto const version = variableVersions.find(variable);
+				key += std::to_string(version == variableVersions.end() ? 0 : version->second) + ",";
+			}
+			occurrences[key].push_back({ node, treeIdx });
+		}
+
+		for (NodeIndex const child : nodes.children(node))
+		{
+			collectOccurrences(nodes, child, treeIdx, variableVersions, occurrences);
+		}
+	}
+
+	void collectSubtree(Nodes const & nodes, NodeIndex node, std::set<NodeIndex> & subtree)
+	{
+		subtree.insert(node);
+		for (NodeIndex const child : nodes.children(node)) collectSubtree(nodes, child, subtree);
+	}
+
+	// Within one straight-line run, each subtree that is worked out more than once with the same variable versions
+	// is kept in a Deferred made before the first statement using it. Bigger subtrees are shared first,
+	// so the smaller ones inside them are not shared separately
+	void shareWithinRun(Nodes & nodes, std::vector<ContextTree> & trees, unsigned start, unsigned end,
+		std::vector<std::pair<unsigned, NodeIndex>> & deferreds, Optimise::Statistics & statistics)
+	{
+		std::map<std::string, unsigned> variableVersions;
+		std::unordered_map<std::string, std::vector<Occurrence>> occurrences;
+
+		for (unsigned i = start; i < end; i++)
+		{
+			if (!isStraightLine(trees[i].type)) continue;
+
+			// in `x = x + y` the right side reads x before it changes
+			NodeIndex const read = trees[i].type == LexemeLine::VAR_CREATION || trees[i].type == LexemeLine::VAR_REDEFINITION
+				? nodes.child(trees[i].root, 1)
+				: trees[i].root;
+			collectOccurrences(nodes, read, i, variableVersions, occurrences);
+
+			std::string assigned;
+			if (assignedVariable(nodes, trees[i], assigned)) variableVersions[assigned]++;
+		}
+
+		std::vector<std::vector<Occurrence> *> repeated;
+		for (auto & keyAndOccurrences : occurrences)
+		{
+			if (keyAndOccurrences.second.size() >= 2) repeated.push_back(&keyAndOccurrences.second);
+		}
+		std::sort(repeated.begin(), repeated.end(), [&nodes](std::vector<Occurrence> const * first, std::vector<Occurrence> const * second)
+		{
+			unsigned const firstSize = sizeOf(nodes, first->front().node), secondSize = sizeOf(nodes, second->front().node);
+			if (firstSize != secondSize) return firstSize > secondSize;
+			return first->front().treeIdx < second->front().treeIdx;
+		});
+
+		// Nodes already inside a shared subtree
+		std::set<NodeIndex> taken;
+		for (std::vector<Occurrence> * group : repeated)
+		{
+			std::vector<Occurrence> free;
+			for (Occurrence const & occurrence : *group)
+			{
+				if (!taken.count(occurrence.node)) free.push_back(occurrence);
+			}
+			if (free.size() < 2) continue;
+
+			for (Occurrence const & occurrence : free) collectSubtree(nodes, occurrence.node, taken);
+
+			std::string const name = "ptitsaCommon" + std::to_string(statistics.commonSubexpressions++);
+			statistics.eliminatedEvaluations += free.size() - 1;
+
+			deferreds.emplace_back(free.front().treeIdx, takeIntoDeferred(nodes, free.front().node, name));
+			for (unsigned i = 1; i < free.size(); i++) replaceWithReadOf(nodes, free[i].node, name);
+		}
+	}
+}
+
+Optimise::Statistics::Statistics() :
+	hoistedInvariants(0),
+	commonSubexpressions(0),
+	eliminatedEvaluations(0)
+{ }
+
+bool Optimise::isPure(Lexer::Function const & function)
+{
+	if (function.type == Lexer::Function::INFIX) return function.identifier != "=" && function.identifier != "in";
+	return std::find(std::begin(pureCommands), std::end(pureCommands), function.identifier) != std::end(pureCommands);
+}
+
+std::string Optimise::structureOf(BuildAST::Nodes const & nodes, BuildAST::NodeIndex node)
+{
+	switch (nodes.kind(node))
+	{
+	case BuildAST::Node::LITERAL:
+		return "L" + std::to_string(nodes.literal(node).type) + nodes.literal(node).value;
+	case BuildAST::Node::VARIABLE:
+		return "V" + nodes.variable(node).identifier;
+	case BuildAST::Node::FUNCTION:
+	{
+		std::string structure = "F" + nodes.function(node).identifier + "(";
+		for (BuildAST::NodeIndex const child : nodes.children(node)) structure += structureOf(nodes, child) + ",";
+		return structure + ")";
+	}
+	default:
+		return "?";
+	}
+}
+
+// Outer loops are done first, so something that changes in neither an inner loop nor the loop around it
+// goes out past both. The inner loop is then looked at on its own, with fewer variables assigned
+void Optimise::hoistLoopInvariants(BuildAST::Nodes & nodes, std::vector<BuildContextTree::ContextTree> & trees, Statistics & statistics)
+{
+	for (unsigned w = 0; w < trees.size(); w++)
+	{
+		if (trees[w].type != LexemeLine::WHILE || w + 1 >= trees.size() || trees[w + 1].type != LexemeLine::SCOPE_ENTER) continue;
+
+		unsigned const loopEnd = scopeEndOf(trees, w + 1);
+		std::set<std::string> assigned;
+		for (unsigned i = w + 1; i < loopEnd; i++)
+		{
+			std::string identifier;
+			if (assignedVariable(nodes, trees[i], identifier)) assigned.insert(identifier);
+			if (assignedItems(nodes, trees, i, identifier)) assigned.insert(identifier);
+		}
+
+		// The body of a parallel loop runs on several threads, and a Deferred is worked out by whichever reads it first
+		std::map<std::string, std::string> namesByStructure;
+		std::vector<NodeIndex> hoisted;
+		for (unsigned i = w; i < loopEnd; i++)
+		{
+			hoistFrom(nodes, trees[i].root, assigned, namesByStructure, hoisted, statistics);
+			if (trees[i].type == LexemeLine::PARALLEL_FOR_EACH && i + 1 < loopEnd && trees[i + 1].type == LexemeLine::SCOPE_ENTER) i = scopeEndOf(trees, i + 1) - 1;
+		}
+
+		unsigned const row = trees[w].row;
+		for (unsigned i = 0; i < hoisted.size(); i++)
+		{
+			trees.insert(trees.begin() + w + i, ContextTree(LexemeLine::DEFERRED_CREATION, row, hoisted[i]));
+		}
+		w += hoisted.size();
+	}
+}
+
+void Optimise::eliminateCommonSubexpressions(BuildAST::Nodes & nodes, std::vector<BuildContextTree::ContextTree> & trees, Statistics & statistics)
+{
+	std::vector<std::pair<unsigned, NodeIndex>> deferreds; // each to go before the tree at its index
+
+	unsigned runStart = 0;
+	for (unsigned i = 0; i <= trees.size(); i++)
+	{
+		bool const endsRun = i == trees.size() || (!isStraightLine(trees[i].type) && trees[i].type != LexemeLine::DEFERRED_CREATION);
+		bool const endsAfter = i < trees.size() && trees[i].type == LexemeLine::IF;
+		if (endsRun || endsAfter)
+		{
+			shareWithinRun(nodes, trees, runStart, endsAfter ? i + 1 : i, deferreds, statistics);
+			runStart = i + 1;
+		}
+	}
+
+	std::stable_sort(deferreds.begin(), deferreds.end(), [](auto const & first, auto const & second) { return first.first > second.first; });
+	for (auto & deferred : deferreds)
+	{
+		unsigned const row = trees[deferred.first].row;
+		trees.insert(trees.begin() + deferred.first, ContextTree(LexemeLine::DEFERRED_CREATION, row, deferred.second));
+	}
+}
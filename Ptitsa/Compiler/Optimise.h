@@ -0,0 +1,39 @@
+#ifndef OPTIMISE_INCLUDE
+#define OPTIMISE_INCLUDE
+
+#include <string>
+#include <vector>
+
+#include "Lexer.h"
+#include "BuildContextTree.h"
+
+// Passes over the context trees that run after they are built and before they are turned into C++
+
+namespace Optimise
+{
+	// What the passes did, shown with --stats
+	struct Statistics
+	{
+		unsigned hoistedInvariants;
+		unsigned commonSubexpressions;
+		unsigned eliminatedEvaluations; // evaluations saved by sharing common subexpressions
+
+		Statistics();
+	};
+
+	// Whether calling the function can do anything other than give back a value, like showing something
+	bool isPure(Lexer::Function const & function);
+
+	// Two subtrees with the same structure give the same value, as long as the variables they read have not changed
+	std::string structureOf(BuildAST::Nodes const & nodes, BuildAST::NodeIndex node);
+
+	// Parts of a while loop that only read variables the loop never assigns to are worked out once, before it.
+	// They are worked out lazily, the first time the loop reaches them, so a loop that never runs does not
+	void hoistLoopInvariants(BuildAST::Nodes & nodes, std::vector<BuildContextTree::ContextTree> & trees, Statistics & statistics);
+
+	// A subtree worked out more than once in a run of statements, while the variables it reads keep their values,
+	// is worked out once. It is kept lazily too, so an `and` or `or` that skips the first use still skips it
+	void eliminateCommonSubexpressions(BuildAST::Nodes & nodes, std::vector<BuildContextTree::ContextTree> & trees, Statistics & statistics);
+}
+
+#endif // !OPTIMISE_INCLUDE
@@ -1,5 +1,6 @@
 #include "Lexer.h"
 #include "Util.h"
+#include "Mistake.h"
 #include <vector>
 #include <algorithm>
 
@@ -8,12 +9,8 @@ namespace
 	using namespace Lexer;
 	using std::static_pointer_cast;
 
-	static std::vector<Variable> definedVars =  { 
-		Variable("pi", 0, 0) 
-	};
-
 	// Helper functions
-	bool varAlreadyDefined(Variable const & var)
+	bool varAlreadyDefined(Variable const & var, std::vector<Variable> const & definedVars)
 	{
 		for (Variable const & definedVar : definedVars)
 		{
@@ -78,18 +75,9 @@ namespace
 		return false;
 	}
 
-	bool groupsContainFunction(std::vector<std::vector<Function>> const & groups, Function const & fn)
-	{
-		for (std::vector<Function> const & group : groups)
-		{
-			if (std::find(group.begin(), group.end(), fn) != group.end()) return true;
-		}
-		return false;
-	}
-
 	// Actual ParseLexeme functions
 
-	void identifyVarCreationsAndRedefinitions(LexemeLine & line)
+	void identifyVarCreationsAndRedefinitions(LexemeLine & line, std::vector<Variable> & definedVars)
 	{
 		if (line.size() >= 2
 			&& line[0]->isVariable()
@@ -100,7 +88,7 @@ namespace
 
 			if (fn.type == Function::INFIX && fn.identifier == "=") 
 			{
-				if (varAlreadyDefined(var))
+				if (varAlreadyDefined(var, definedVars))
 				{
 					line.type = LexemeLine::VAR_REDEFINITION;
 				}
@@ -123,11 +111,148 @@ namespace
 			{
 				case Keyword::IF:		line.type = LexemeLine::IF;			break;
 				case Keyword::WHILE:	line.type = LexemeLine::WHILE;		break;
+				case Keyword::FOR_EACH:	line.type = LexemeLine::FOR_EACH;	break;
+				case Keyword::PARALLEL_FOR_EACH:	line.type = LexemeLine::PARALLEL_FOR_EACH;	break;
 			}
 			line.erase(0);	// dont need keyword anymore, type already known
 		}
 	}
 
+	// Variables every part of a program has, commands included
+	std::vector<Variable> builtinVariables() { return { Variable("pi", 0, 0) }; }
+
+	// The command whose body is being parsed, if any, and the program's variables, hidden while in it
+	struct CommandBody
+	{
+		bool inside = false;
+		std::string name;
+		std::vector<Variable> outerVars;
+	};
+
+	// A command's arguments, and the `result` it gives back, are defined only in its body.
+	// Variables made in the body are forgotten once it ends, as they belong to the command.
+	// A command is made outside the program's code, so it cannot see the program's variables
+	void scopeCommandVariables(LexemeLine const & line, std::vector<Variable> & definedVars, CommandBody & command)
+	{
+		if (line.type == LexemeLine::COMMAND_DECLARATION)
+		{
+			if (!command.inside) command.outerVars = std::move(definedVars);
+			command.inside = true;
+			command.name.clear();
+			definedVars = builtinVariables();
+
+			for (PLexeme const & lex : line)
+			{
+				if (lex->isFunction() && command.name.empty()) command.name = static_pointer_cast<Function>(lex)->identifier;
+				if (lex->isVariable()) definedVars.push_back(*static_pointer_cast<Variable>(lex));
+			}
+			definedVars.push_back(Variable("result", 0, 0));
+		}
+		else if (command.inside
+			&& line.depth == 0
+			&& line.type != LexemeLine::SCOPE_ENTER
+			&& line.type != LexemeLine::SCOPE_EXIT)
+		{
+			definedVars = std::move(command.outerVars);
+			command.inside = false;
+		}
+	}
+
+	// Every variable a command's body reads has to be one of the command's own, or the C++ would not build
+	void checkCommandReads(LexemeLine const & line, std::vector<Variable> const & definedVars, CommandBody const & command)
+	{
+		if (!command.inside || line.type == LexemeLine::COMMAND_DECLARATION) return;
+
+		for (unsigned i = 0; i < line.size(); i++)
+		{
+			bool const isMade = i == 0 && (line.type == LexemeLine::VAR_CREATION || line.type == LexemeLine::FOR_EACH || line.type == LexemeLine::PARALLEL_FOR_EACH);
+			if (isMade || !line[i]->isVariable()) continue;
+
+			Variable const & var = *static_pointer_cast<Variable>(line[i]);
+			if (varAlreadyDefined(var, definedVars)) continue;
+
+			bool const isProgramVariable = varAlreadyDefined(var, command.outerVars);
+			throw Mistake::Variable_Does_Not_Exist("'" + command.name + "' uses '" + var.identifier + "', which is not one of its arguments, nor made in it"
+				+ (isProgramVariable ? ". A command cannot see the program's variables: pass '" + var.identifier + "' to it as an argument." : "."), line.row);
+		}
+	}
+
+	// A for each loop in the body of a parallel loop, going over a list from outside the body
+	struct LoopOverShared
+	{
+		Variable variable;
+		std::string items;
+		unsigned depth;
+	};
+
+	// The body of a parallel loop: where its variables start in definedVars, the depth of the loop's line,
+	// and the loops in it over lists from outside it
+	struct ParallelBody
+	{
+		unsigned varsBefore;
+		unsigned depth;
+		std::vector<LoopOverShared> loopsOverShared;
+	};
+
+	// Whether var is a variable from outside the parallel loop whose body this is, rather than one the body made
+	bool isFromOutside(Variable const & var, std::vector<Variable> const & definedVars, ParallelBody const & body)
+	{
+		for (unsigned i = body.varsBefore; i < definedVars.size(); i++)
+		{
+			if (definedVars[i] <= var) return false; // the body's own, even if one outside has the same name
+		}
+		for (unsigned i = 0; i < body.varsBefore; i++)
+		{
+			if (definedVars[i].depth <= body.depth && definedVars[i] <= var) return true;
+		}
+		return false;
+	}
+
+	// A for each loop's variable is defined in its body. The iterations of a parallel loop run at the same time,
+	// so its body may only change its own variable and variables it made: changing one from outside the loop
+	// would have the iterations race to change it. Assigning to the variable of a loop over a list from outside
+	// changes that list, so is not allowed either
+	void scopeLoopVariables(LexemeLine const & line, std::vector<Variable> & definedVars, std::vector<ParallelBody> & parallelBodies)
+	{
+		bool const isScopeLine = line.type == LexemeLine::SCOPE_ENTER || line.type == LexemeLine::SCOPE_EXIT;
+		while (!isScopeLine && !parallelBodies.empty() && line.depth <= parallelBodies.back().depth) parallelBodies.pop_back();
+		if (!isScopeLine && !parallelBodies.empty())
+		{
+			std::vector<LoopOverShared> & loops = parallelBodies.back().loopsOverShared;
+			while (!loops.empty() && line.depth <= loops.back().depth) loops.pop_back();
+		}
+
+		if (line.type == LexemeLine::FOR_EACH || line.type == LexemeLine::PARALLEL_FOR_EACH) // x in items
+		{
+			Variable const & var = *static_pointer_cast<Variable>(line[0]);
+			if (!parallelBodies.empty() && line.size() == 3 && line[2]->isVariable())
+			{
+				Variable const & items = *static_pointer_cast<Variable>(line[2]);
+				if (isFromOutside(items, definedVars, parallelBodies.back())) parallelBodies.back().loopsOverShared.push_back({ var, items.identifier, line.depth });
+			}
+			if (line.type == LexemeLine::PARALLEL_FOR_EACH) parallelBodies.push_back({ static_cast<unsigned>(definedVars.size()), line.depth, { } });
+			definedVars.push_back(var);
+		}
+		else if (line.type == LexemeLine::VAR_REDEFINITION && !parallelBodies.empty())
+		{
+			Variable const & var = *static_pointer_cast<Variable>(line[0]);
+			for (ParallelBody const & body : parallelBodies)
+			{
+				for (LoopOverShared const & loop : body.loopsOverShared)
+				{
+					if (loop.variable.identifier != var.identifier) continue;
+					throw Mistake::Not_Safe_In_Parallel("Changing '" + var.identifier + "' changes '" + loop.items + "', which every run of a parallel loop goes over at once. "
+						"Change the items after the loop, or make the loop an ordinary for each.", line.row);
+				}
+			}
+			if (isFromOutside(var, definedVars, parallelBodies.back()))
+			{
+				throw Mistake::Not_Safe_In_Parallel("'" + var.identifier + "' is changed by every run of a parallel loop at once. "
+					"Change it after the loop, or make the loop an ordinary for each.", line.row);
+			}
+		}
+	}
+
 	void identifyVoidFunctionCalls(LexemeLine & line)
 	{
 		if (line.isEmpty()) return;
@@ -138,37 +263,30 @@ namespace
 		}
 	}
 
+	// A scope line is added for every level the indentation goes up or down by, so blocks nested in blocks close properly
 	void generateScopeLines(std::vector<LexemeLine> & lexemeDoc)
 	{
+		if (lexemeDoc.empty()) return;
+
 		LexemeLine const scopeEneterLine = LexemeLine(LexemeLine::SCOPE_ENTER);
 		LexemeLine const scopeExitLine = LexemeLine(LexemeLine::SCOPE_EXIT);
 
-		unsigned r = 1;
+		std::vector<LexemeLine> withScopeLines;
+		unsigned depth = lexemeDoc.front().depth;
 
-		while (r < lexemeDoc.size())
-		{
-			if (lexemeDoc[r].depth > lexemeDoc[r - 1].depth)
-			{
-				removeIndentLexemes(lexemeDoc[r]);
-				lexemeDoc.insert(lexemeDoc.begin() + r, scopeEneterLine);
-				r += 2;
-			}
-			else if (lexemeDoc[r].depth < lexemeDoc[r - 1].depth)
-			{
-				removeIndentLexemes(lexemeDoc[r]);				
-				lexemeDoc.insert(lexemeDoc.begin() + r, scopeExitLine);
-				r += 2;
-			}
-			else r++;
-		}
-		if (!lexemeDoc.empty() && lexemeDoc.back().depth > lexemeDoc.front().depth)
+		for (LexemeLine & line : lexemeDoc)
 		{
-			removeIndentLexemes(lexemeDoc.back());
-			lexemeDoc.push_back(scopeExitLine);
+			removeIndentLexemes(line);
+			for (; depth < line.depth; depth++) withScopeLines.push_back(scopeEneterLine);
+			for (; depth > line.depth; depth--) withScopeLines.push_back(scopeExitLine);
+			withScopeLines.push_back(std::move(line));
 		}
+		for (; depth > lexemeDoc.front().depth; depth--) withScopeLines.push_back(scopeExitLine);
+
+		lexemeDoc = std::move(withScopeLines);
 	}
 	
-	void setOrderLookingAtGroup(LexemeLine & line, unsigned start, unsigned end, unsigned & highestOrder, std::vector<Function> const & group)
+	void setOrderOfPrecedence(LexemeLine & line, unsigned start, unsigned end, unsigned & highestOrder, Function::Precedence precedence)
 	{
 		for (unsigned i = start; i <= end; i++)
 		{
@@ -176,8 +294,7 @@ namespace
 			{
 				PFunction const fn = static_pointer_cast<Function>(line[i]);
 
-				if (!fn->processed && 
-					std::find(group.begin(), group.end(), *fn) != group.end())
+				if (!fn->processed && fn->precedence == precedence)
 				{
 					fn->order = highestOrder++;
 					fn->processed = true;
@@ -189,7 +306,7 @@ namespace
 
 	void setOrder(LexemeLine & line, unsigned start, unsigned end, unsigned & highestOrder)
 	{
-		if (start == end) return;
+		if (start > end) return; // a bracket with nothing in it. One holding just a command without arguments, like `( greet )`, still orders it
 
 		unsigned openIdx, closeIdx = 0;
 		while (couldSetInnerBracketIndexes(line, start, end, openIdx, closeIdx))
@@ -197,16 +314,9 @@ namespace
 			setOrder(line, openIdx + 1, closeIdx - 1, highestOrder);
 		}
 
-		for (std::vector<Function> const & precedenceGroup : opsBeforeCommands)
+		for (unsigned precedence = 0; precedence < Function::PRECEDENCES; precedence++)
 		{
-			setOrderLookingAtGroup(line, start, end, highestOrder, precedenceGroup);
-		}
-			
-		setOrderLookingAtGroup(line, start, end, highestOrder, commands);
-
-		for (std::vector<Function> const & precedenceGroup : opsAfterCommands)
-		{
-			setOrderLookingAtGroup(line, start, end, highestOrder, precedenceGroup);
+			setOrderOfPrecedence(line, start, end, highestOrder, static_cast<Function::Precedence>(precedence));
 		}
 	}
 
@@ -224,10 +334,18 @@ void Lexer::parseTypedLexemes(std::vector<Lexer::LexemeLine> & lexemeDoc)
 {
 	generateScopeLines(lexemeDoc);
 
+	std::vector<Variable> definedVars = builtinVariables(); // this compile's own, so compiles on other threads do not share it
+	CommandBody command;
+	std::vector<ParallelBody> parallelBodies;
+
 	for (LexemeLine & line : lexemeDoc)
 	{
-		identifyVarCreationsAndRedefinitions(line);
+		scopeCommandVariables(line, definedVars, command);
+
+		identifyVarCreationsAndRedefinitions(line, definedVars);
 		identifyStatements(line);
+		scopeLoopVariables(line, definedVars, parallelBodies);
+		checkCommandReads(line, definedVars, command);
 		identifyVoidFunctionCalls(line);
 
 		setOrder(line);
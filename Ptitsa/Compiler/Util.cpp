@@ -51,6 +51,28 @@ void Util::removeLast(std::string & string, char toRemove)
 	}
 }
 
+std::uint64_t Util::fnv1a(std::string const & string)
+{
+	return fnv1a(string.data(), string.size(), 0xcbf29ce484222325);
+}
+
+std::uint64_t Util::fnv1a(char const * bytes, std::size_t length, std::uint64_t hash)
+{
+	for (std::size_t i = 0; i < length; i++)
+	{
+		hash ^= static_cast<unsigned char>(bytes[i]);
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+std::string Util::toHex(std::uint64_t number)
+{
+	std::ostringstream stream;
+	stream << std::hex << number;
+	return stream.str();
+}
+
 bool Util::isNumber(std::string const & string)
 {
 	if (!(isDigit(string[0]) || string[0] == '.' || string[0] == '-')) return false;
@@ -82,18 +104,19 @@ std::string Util::toDecimal(std::string const & number)
 	return number + ".0";
 }
 
-void Util::mollysPrintAST(BuildAST::PASTNode const & node, unsigned level)
+void Util::mollysPrintAST(BuildAST::Nodes const & nodes, BuildAST::NodeIndex node, unsigned level)
 {
 	for (unsigned i = 0; i <= level; ++i) std::cout << "   ";
-	std::cout << " " << node->lex << std::endl;
+	if (nodes.isEmpty(node)) std::cout << std::endl;
+	else std::cout << " " << nodes.lexeme(node) << std::endl;
 
-	for (BuildAST::PASTNode const & child : node->children)
+	for (BuildAST::NodeIndex const child : nodes.children(node))
 	{
-		mollysPrintAST(child, level + 1);
+		mollysPrintAST(nodes, child, level + 1);
 	}
 }
 
-void Util::mollysPrintAST(BuildAST::PASTNode const & root) { mollysPrintAST(root, 0); }
+void Util::mollysPrintAST(BuildAST::Nodes const & nodes, BuildAST::NodeIndex root) { mollysPrintAST(nodes, root, 0); }
 
 int Util::bracketPolarity(Lexer::LexemeLine const & line, unsigned start, unsigned end)
 {
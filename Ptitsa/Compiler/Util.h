@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <iostream>
 #include <vector>
+#include <cstdint>
 
 #include "Lexer.h"
 #include "BuildAST.h"
@@ -15,7 +16,7 @@ namespace Util
 	//void printLexemeRow(const std::vector<Lexer::Lexeme>&);
 	//void printLexemeDocument(const std::vector<Lexer::LexemeLine>&);
 	
-	template <typename T> bool couldSetIndex(std::vector<T> vector, T item, unsigned& index) 
+	template <typename Vector, typename T> bool couldSetIndex(Vector const & vector, T const & item, unsigned& index) 
 	{ 
 		unsigned position = std::distance(vector.begin(), std::find(vector.begin(), vector.end(), item));
 		if (position < vector.size())
@@ -30,12 +31,16 @@ namespace Util
 	void replaceAll(std::string & parent, std::string const & from, std::string const & to);
 	char lastNonWhitespace(std::string const & string);
 		
+	std::uint64_t fnv1a(std::string const & string);
+	std::uint64_t fnv1a(char const * bytes, std::size_t length, std::uint64_t hash); // goes on from `hash`, so several pieces hash as one
+	std::string toHex(std::uint64_t number);
+
 	bool isDigit(char);
 	bool isNumber(std::string const & string);
 	std::string toDecimal(std::string const & number);
 		
-	void mollysPrintAST(BuildAST::PASTNode const & node, unsigned level);
-	void mollysPrintAST(BuildAST::PASTNode const & root);
+	void mollysPrintAST(BuildAST::Nodes const & nodes, BuildAST::NodeIndex node, unsigned level);
+	void mollysPrintAST(BuildAST::Nodes const & nodes, BuildAST::NodeIndex root);
 	//void printContextTrees(const std::vector<BuildContextTree::ContextTree*>&);
 	//void deleteContextTrees(std::vector<BuildContextTree::ContextTree*>&);
 	
@@ -0,0 +1,157 @@
+#ifndef VOCABULARY_INCLUDE
+#define VOCABULARY_INCLUDE
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+#include "Lexer.h"
+
+// The words the language knows before any program is read: functions, keywords and symbols.
+// Each is kept in a perfect hash table worked out while the compiler is being compiled, so finding a word
+// is one hash and one compare, and nothing is built when the compiler starts.
+
+namespace Vocabulary
+{
+	template <typename Value> struct Entry
+	{
+		std::string_view key;
+		Value value;
+	};
+
+	// FNV-1a, with the seed mixed in at the start. The last character only reaches the low bits,
+	// so the result is stirred once more before the top bits are used as the index
+	constexpr std::uint64_t seededHash(std::string_view key, std::uint64_t seed)
+	{
+		std::uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+		for (char const c : key)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ULL;
+		}
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDULL;
+		return hash ^ (hash >> 33);
+	}
+
+	template <typename Value, std::size_t Count> class PerfectHashTable
+	{
+	public:
+		static constexpr unsigned BITS = Count <= 4 ? 4 : Count <= 8 ? 5 : Count <= 16 ? 6 : Count <= 32 ? 7 : 8;
+		static constexpr std::size_t SIZE = std::size_t(1) << BITS;
+		static_assert(Count * 4 <= SIZE, "Vocabulary tables are for a few dozen words at most");
+
+		constexpr PerfectHashTable(Entry<Value> const (&entries)[Count]) :
+			seed(0),
+			perfect(false),
+			keys(),
+			values(),
+			used()
+		{
+			for (std::uint64_t trySeed = 1; trySeed < 100000 && !perfect; trySeed++)
+			{
+				if (isPerfectWith(entries, trySeed))
+				{
+					seed = trySeed;
+					perfect = true;
+				}
+			}
+			for (std::size_t i = 0; perfect && i < Count; i++)
+			{
+				std::size_t const slot = slotOf(entries[i].key, seed);
+				keys[slot] = entries[i].key;
+				values[slot] = entries[i].value;
+				used[slot] = true;
+			}
+		}
+
+		constexpr bool isPerfect() const { return perfect; }
+
+		// nullptr if the word is not in the table
+		constexpr Value const * find(std::string_view key) const
+		{
+			std::size_t const slot = slotOf(key, seed);
+			return used[slot] && keys[slot] == key ? &values[slot] : nullptr;
+		}
+
+	private:
+		std::uint64_t seed;
+		bool perfect;
+		std::string_view keys[SIZE];
+		Value values[SIZE];
+		bool used[SIZE];
+
+		static constexpr std::size_t slotOf(std::string_view key, std::uint64_t seed)
+		{
+			return static_cast<std::size_t>(seededHash(key, seed) >> (64 - BITS));
+		}
+
+		static constexpr bool isPerfectWith(Entry<Value> const (&entries)[Count], std::uint64_t trySeed)
+		{
+			bool taken[SIZE] = { };
+			for (std::size_t i = 0; i < Count; i++)
+			{
+				std::size_t const slot = slotOf(entries[i].key, trySeed);
+				if (taken[slot]) return false;
+				taken[slot] = true;
+			}
+			return true;
+		}
+	};
+
+	template <typename Value, std::size_t Count> constexpr PerfectHashTable<Value, Count> makeTable(Entry<Value> const (&entries)[Count])
+	{
+		return PerfectHashTable<Value, Count>(entries);
+	}
+
+	struct BuiltinFunction
+	{
+		std::string_view asCpp = "";
+		Lexer::Function::Type type = Lexer::Function::UNKNOWN;
+		int args = 0; // value of -1 means takes any amount of args
+		Lexer::Function::Precedence precedence = Lexer::Function::COMMAND;
+	};
+
+	inline constexpr auto functions = makeTable<BuiltinFunction>({
+		{ "^",			{ "^",					Lexer::Function::INFIX,		2,	Lexer::Function::POWER } },
+		{ "*",			{ "*",					Lexer::Function::INFIX,		2,	Lexer::Function::PRODUCT } },
+		{ "/",			{ "/",					Lexer::Function::INFIX,		2,	Lexer::Function::PRODUCT } },
+		{ "+",			{ "+",					Lexer::Function::INFIX,		2,	Lexer::Function::SUM } },
+		{ "-",			{ "-",					Lexer::Function::INFIX,		2,	Lexer::Function::SUM } },
+		{ "not",		{ "!",					Lexer::Function::PREFIX,	1,	Lexer::Function::COMMAND } },
+		{ "show",		{ "Library::show",		Lexer::Function::PREFIX,	-1,	Lexer::Function::COMMAND } },
+		{ "exp",		{ "Library::exp",		Lexer::Function::PREFIX,	1,	Lexer::Function::COMMAND } },
+		{ "length",		{ "Library::length",	Lexer::Function::PREFIX,	1,	Lexer::Function::COMMAND } },
+		{ "sum",		{ "Library::sum",		Lexer::Function::PREFIX,	1,	Lexer::Function::COMMAND } },
+		{ "max",		{ "Library::max",		Lexer::Function::PREFIX,	1,	Lexer::Function::COMMAND } },
+		{ "sort",		{ "Library::sort",		Lexer::Function::PREFIX,	1,	Lexer::Function::COMMAND } },
+		{ "contains",	{ "Library::contains",	Lexer::Function::PREFIX,	2,	Lexer::Function::COMMAND } },
+		{ "reverse",	{ "Library::reverse",	Lexer::Function::PREFIX,	1,	Lexer::Function::COMMAND } },
+		{ "read file",	{ "Library::readFile",	Lexer::Function::PREFIX,	1,	Lexer::Function::COMMAND } },
+		{ "read lines",	{ "Library::readLines",	Lexer::Function::PREFIX,	1,	Lexer::Function::COMMAND } },
+		{ "write file",	{ "Library::writeFile",	Lexer::Function::PREFIX,	2,	Lexer::Function::COMMAND } },
+		{ "to",			{ "Library::range",		Lexer::Function::INFIX,		2,	Lexer::Function::COMMAND } },
+		{ "is",			{ "==",					Lexer::Function::INFIX,		2,	Lexer::Function::COMPARISON } },
+		{ "isnt",		{ "!=",					Lexer::Function::INFIX,		2,	Lexer::Function::COMPARISON } },
+		{ "and",		{ "&&",					Lexer::Function::INFIX,		2,	Lexer::Function::AND } },
+		{ "or",			{ "||",					Lexer::Function::INFIX,		2,	Lexer::Function::OR } },
+		{ "=",			{ "=",					Lexer::Function::INFIX,		2,	Lexer::Function::ASSIGNMENT } }
+	});
+
+	inline constexpr auto keywords = makeTable<Lexer::Keyword::Type>({
+		{ "if",			Lexer::Keyword::IF },
+		{ "foreach",	Lexer::Keyword::FOR_EACH },
+		{ "while",		Lexer::Keyword::WHILE }
+	});
+
+	inline constexpr auto symbols = makeTable<Lexer::Symbol::Type>({
+		{ "(",	Lexer::Symbol::OPEN_BRACKET },
+		{ ")",	Lexer::Symbol::CLOSE_BRACKET },
+		{ ",",	Lexer::Symbol::ARGS_SEP },
+		{ ":",	Lexer::Symbol::COLON }
+	});
+
+	static_assert(functions.isPerfect() && keywords.isPerfect() && symbols.isPerfect(), "Could not find a perfect hash for the vocabulary");
+}
+
+#endif // !VOCABULARY_INCLUDE
@@ -0,0 +1,50 @@
+#include <mutex>
+
+#include "Arena.h"
+#include "Parallel.h"
+
+namespace
+{
+	// The arena's own resources are not made to be used by several threads at once. Outside parallel loops a program
+	// has one thread, so the arena is only locked while one runs, and the rest of the program pays nothing for it
+	class TakingTurns : public std::pmr::memory_resource
+	{
+	public:
+		explicit TakingTurns(std::unique_ptr<std::pmr::memory_resource> resource) : resource(std::move(resource)) { }
+
+	private:
+		std::unique_ptr<std::pmr::memory_resource> resource;
+		std::mutex mutex;
+
+		void * do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			if (!Library::Parallel::isRunning()) return resource->allocate(bytes, alignment);
+			std::lock_guard<std::mutex> lock(mutex);
+			return resource->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void * p, std::size_t bytes, std::size_t alignment) override
+		{
+			if (!Library::Parallel::isRunning()) return resource->deallocate(p, bytes, alignment);
+			std::lock_guard<std::mutex> lock(mutex);
+			resource->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override { return this == &other; }
+	};
+}
+
+Library::Arena::Arena(Library::Arena::Kind kind)
+{
+	std::unique_ptr<std::pmr::memory_resource> own;
+	if (kind == MONOTONIC) own = std::make_unique<std::pmr::monotonic_buffer_resource>();
+	else own = std::make_unique<std::pmr::unsynchronized_pool_resource>();
+	resource = std::make_unique<TakingTurns>(std::move(own));
+
+	previous = std::pmr::set_default_resource(resource.get());
+}
+
+Library::Arena::~Arena()
+{
+	std::pmr::set_default_resource(previous);
+}
@@ -0,0 +1,29 @@
+#ifndef ARENA_INCLUDE
+#define ARENA_INCLUDE
+
+#include <memory>
+#include <memory_resource>
+
+namespace Library
+{
+	// While an Arena is alive it is the default memory resource, so every phrase and list made allocates from it
+	// rather than the global heap, and everything is given back in one go when it is destroyed.
+	// POOL reuses freed blocks. MONOTONIC never frees before the end, which suits programs that mostly build up data.
+	// Objects made while it is alive must not outlive it. While a parallel loop runs, its threads take turns with it
+	class Arena
+	{
+	public:
+		enum Kind { POOL, MONOTONIC };
+
+		explicit Arena(Kind kind);
+		Arena(Arena const &) = delete;
+		Arena & operator=(Arena const &) = delete;
+		~Arena();
+
+	private:
+		std::unique_ptr<std::pmr::memory_resource> resource;
+		std::pmr::memory_resource * previous;
+	};
+}
+
+#endif // !ARENA_INCLUDE
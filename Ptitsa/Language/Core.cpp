@@ -1,15 +1,184 @@
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string_view>
+
+#ifdef PTITSA_PARALLEL_ALGORITHMS
+#include <execution>
+#endif
 
 #include "Core.h"
 #include "Object.h"
 #include "Core.h"
+#include "Kernels.h"
 #include "../Compiler/Mistake.h"
+#include "../Compiler/MappedFile.h"
+
+namespace
+{
+	using namespace BuiltinType;
+
+	// Below this many elements, starting up the parallel algorithms costs more than it saves
+	std::ptrdiff_t const parallelThreshold = 1 << 14;
+
+	bool numberBefore(double first, double second) { return first < second || (std::isnan(second) && !std::isnan(first)); } // NaN goes last
+
+	template <typename Iterator, typename Compare> void sortRange(Iterator begin, Iterator end, Compare before)
+	{
+#ifdef PTITSA_PARALLEL_ALGORITHMS
+		if (end - begin >= parallelThreshold)
+		{
+			std::sort(std::execution::par, begin, end, before);
+			return;
+		}
+#endif
+		std::sort(begin, end, before);
+	}
+
+	template <typename Iterator, typename T> Iterator findInRange(Iterator begin, Iterator end, T const& item)
+	{
+#ifdef PTITSA_PARALLEL_ALGORITHMS
+		if (end - begin >= parallelThreshold) return std::find(std::execution::par, begin, end, item);
+#endif
+		return std::find(begin, end, item);
+	}
+
+	bool allOfType(Object::List const& list, Object::ObjectType type)
+	{
+		return std::all_of(list.begin(), list.end(), [type](Object const& element) { return element.type == type; });
+	}
+
+	std::string pathToRead(Object const& path)
+	{
+		if (path.type != Object::PHRASE) throw Mistake::Wrong_Type_Used("Could not read a file named by a " + path.typeAsString());
+		return std::string(path.phrase);
+	}
+
+	// The line starting at `from`, without its ending, which may be \r\n. Sets `from` to the start of the next one
+	std::pair<char const*, char const*> takeLine(char const*& from, char const* last)
+	{
+		char const* const newline = static_cast<char const*>(std::memchr(from, '\n', last - from));
+		char const* const end = newline ? newline : last;
+		char const* const begin = from;
+		from = newline ? newline + 1 : last;
+		return { begin, end > begin && end[-1] == '\r' ? end - 1 : end };
+	}
+
+	// A file being written, with a large buffer of its own, so writing a line at a time rarely reaches the disk
+	struct Writer
+	{
+		std::vector<char> buffer;
+		std::ofstream stream;
+
+		explicit Writer(std::string const& path) : buffer(1 << 20)
+		{
+			stream.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			stream.open(path, std::ios::binary | std::ios::trunc);
+			if (!stream) throw Mistake::File_Does_Not_Exist("Could not write to " + path);
+		}
+	};
 
-bool Library::isTrue(bool b) { return b; }
-bool Library::isTrue(BuiltinType::Object const& object)
+	// The files written so far in this run, by path. Destroyed when the program ends, which writes out what is left in the buffers
+	struct Writers
+	{
+		std::mutex mutex; // parallel loops may write too
+		std::map<std::string, std::unique_ptr<Writer>, std::less<>> byPath; // found by the phrase itself, without copying it
+	};
+
+	Writers& writers()
+	{
+		static Writers writers;
+		return writers;
+	}
+
+	// So that reading a file this run has written reads what was written
+	void flushWrites(std::string const& path)
+	{
+		std::lock_guard<std::mutex> lock(writers().mutex);
+		auto const found = writers().byPath.find(path);
+		if (found != writers().byPath.end()) found->second->stream.flush();
+	}
+}
+
+void Library::addToInPlaceSlowly(BuiltinType::Object& target, BuiltinType::Object const& addition)
+{
+	if (target.type == Object::NUMBER_LIST)
+	{
+		if (addition.type == Object::NUMBER)
+		{
+			target.numbers.push_back(addition.number);
+			target.changedInPlace();
+			return;
+		}
+		else if (addition.type == Object::NUMBER_LIST)
+		{
+			if (&addition == &target) // inserting a range from the vector being grown is not allowed
+			{
+				Object::Numbers const copy = addition.numbers;
+				target.numbers.insert(target.numbers.end(), copy.begin(), copy.end());
+			}
+			else target.numbers.insert(target.numbers.end(), addition.numbers.begin(), addition.numbers.end());
+			target.changedInPlace();
+			return;
+		}
+		target.promoteToList(); // something other than a number is going in
+	}
+
+	if (target.type == Object::LIST)
+	{
+		if (addition.isList())
+		{
+			bool const aliasesTarget = &addition == &target
+				|| (&addition >= target.list.data() && &addition < target.list.data() + target.list.size());
+
+			if (aliasesTarget) // inserting a range from the vector being grown is not allowed
+			{
+				Object const copy = addition;
+				addToInPlace(target, copy);
+				return;
+			}
+			else if (addition.type == Object::LIST) target.list.insert(target.list.end(), addition.list.begin(), addition.list.end());
+			else target.list.insert(target.list.end(), addition.numbers.begin(), addition.numbers.end());
+		}
+		else target.list.push_back(addition);
+	}
+	else if (target.type == Object::PHRASE && addition.type == Object::PHRASE) target.phrase += addition.phrase;
+	else
+	{
+		target = target + addition;
+		return;
+	}
+	target.changedInPlace();
+}
+
+thread_local std::string* Library::shownText = nullptr;
+
+Library::Alternatives::Alternatives(std::initializer_list<Object> alternatives)
+{
+	for (Object const& alternative : alternatives)
+	{
+		if (alternative.type == Object::NUMBER) numbers.push_back(alternative.number);
+		else others.insert(alternative);
+	}
+	std::sort(numbers.begin(), numbers.end());
+}
+
+bool Library::Alternatives::contains(Object const& item) const
+{
+	if (item.type == Object::NUMBER)
+	{
+		auto const found = std::lower_bound(numbers.begin(), numbers.end(), item.number);
+		return found != numbers.end() && *found == item.number; // not binary_search, which would find NaN
+	}
+	return others.count(item) > 0;
+}
+
+void Library::notTrueOrFalse(BuiltinType::Object const& object)
 {
-	if (object.type == Object::BOOLEAN) return object.boolean;
 	throw Mistake::Wrong_Type_Used("Cannot check whether a " + object.typeAsString() + " is true or false.");
 }
 
@@ -17,5 +186,255 @@ BuiltinType::Object Library::exp(BuiltinType::Object const& power)
 {
 
 	if (power.type == Object::NUMBER) return Object(pow(2.71828182845904523536, power.number));
+	if (power.type == Object::NUMBER_LIST)
+	{
+		Object::Numbers results(power.numbers.size());
+		Kernels::exp(power.numbers.data(), results.data(), power.numbers.size());
+		return Object(std::move(results));
+	}
 	throw Mistake::Wrong_Type_Used("Could not run 'exp' on a " + power.typeAsString());
 }
+
+
+BuiltinType::Object Library::range(BuiltinType::Object const& first, BuiltinType::Object const& last)
+{
+	if (first.type != Object::NUMBER || last.type != Object::NUMBER)
+	{
+		throw Mistake::Wrong_Type_Used("Could not count from a " + first.typeAsString() + " to a " + last.typeAsString());
+	}
+	if (!std::isfinite(first.number) || !std::isfinite(last.number))
+	{
+		throw Mistake::Bad_Number_Used("Could not count from " + std::to_string(first.number) + " to " + std::to_string(last.number) + ", as only finite numbers can be counted between.");
+	}
+
+	Object::Numbers numbers;
+	if (last.number >= first.number) numbers.reserve(static_cast<std::size_t>(last.number - first.number) + 1);
+	for (double number = first.number; number <= last.number; number++) numbers.push_back(number);
+	return Object(std::move(numbers));
+}
+
+Library::Each::Each(BuiltinType::Object& items, bool changesItems) :
+	items(items),
+	index(0),
+	changesItems(changesItems)
+{
+	if (!items.isList()) throw Mistake::Wrong_Type_Used("Could not go over each item of a " + items.typeAsString());
+}
+
+Library::Each::Each(BuiltinType::Object const& items, bool) :
+	Each(Object(items), false)
+{ }
+
+// The list is the loop's own, so nothing reads what would be put back into it
+Library::Each::Each(BuiltinType::Object&& items, bool) :
+	owned(std::move(items)),
+	items(owned),
+	index(0),
+	changesItems(false)
+{
+	if (!owned.isList()) throw Mistake::Wrong_Type_Used("Could not go over each item of a " + owned.typeAsString());
+}
+
+Library::Each::Iterator Library::Each::begin()
+{
+	if (hasCurrent()) load();
+	return Iterator(*this);
+}
+
+void Library::Each::load()
+{
+	if (items.type == Object::NUMBER_LIST) current = items.numbers[index];
+	else current = items.list[index];
+}
+
+// Unless the body took the item out of the list, or made the list something else. A body that never assigns to the item
+// leaves the list alone, so loops that only read a list can run at once on it, as they do in the body of a parallel loop
+void Library::Each::putBack()
+{
+	if (!changesItems || !hasCurrent()) return;
+
+	if (items.type == Object::NUMBER_LIST && current.type == Object::NUMBER) items.numbers[index] = current.number;
+	else
+	{
+		items.promoteToList();
+		items.list[index] = std::move(current);
+	}
+	items.changedInPlace();
+}
+
+void Library::Each::next()
+{
+	putBack();
+	index++;
+	if (hasCurrent()) load();
+}
+
+BuiltinType::Object Library::length(BuiltinType::Object const& object)
+{
+	if (object.isList()) return Object(static_cast<double>(object.listSize()));
+	if (object.type == Object::PHRASE) return Object(static_cast<double>(object.phrase.size()));
+	throw Mistake::Wrong_Type_Used("Could not find the length of a " + object.typeAsString());
+}
+
+BuiltinType::Object Library::sum(BuiltinType::Object const& list)
+{
+	// Both ways of storing a list add up in the same order, so equal lists have equal sums to the last bit
+	if (list.type == Object::NUMBER_LIST) return Object(Kernels::sum(list.numbers.data(), list.numbers.size()));
+	if (list.type == Object::LIST)
+	{
+		Kernels::Sum total;
+		for (Object const& element : list.list)
+		{
+			if (element.type != Object::NUMBER) throw Mistake::Wrong_Type_Used("Could not add up a list containing a " + element.typeAsString());
+			total.add(element.number);
+		}
+		return Object(total.total());
+	}
+	throw Mistake::Wrong_Type_Used("Could not add up a " + list.typeAsString());
+}
+
+BuiltinType::Object Library::max(BuiltinType::Object const& list)
+{
+	if (!list.isList()) throw Mistake::Wrong_Type_Used("Could not find the largest item of a " + list.typeAsString());
+	if (list.listSize() == 0) throw Mistake::Item_Not_In_List("Could not find the largest item of an empty list.");
+
+	if (list.type == Object::NUMBER_LIST) return Object(*std::max_element(list.numbers.begin(), list.numbers.end(), numberBefore));
+	if (allOfType(list.list, Object::NUMBER)) // a list of numbers once held something else, and is still stored as a LIST
+	{
+		return *std::max_element(list.list.begin(), list.list.end(), [](Object const& first, Object const& second) { return numberBefore(first.number, second.number); });
+	}
+	if (allOfType(list.list, Object::PHRASE))
+	{
+		return *std::max_element(list.list.begin(), list.list.end(), [](Object const& first, Object const& second) { return first.phrase < second.phrase; });
+	}
+	throw Mistake::Wrong_Type_Used("Could only find the largest item of a list of numbers or of phrases.");
+}
+
+BuiltinType::Object Library::sort(BuiltinType::Object const& list)
+{
+	if (list.type == Object::NUMBER_LIST)
+	{
+		Object::Numbers sorted = list.numbers;
+		sortRange(sorted.begin(), sorted.end(), numberBefore);
+		return Object(std::move(sorted));
+	}
+	if (list.type == Object::LIST && allOfType(list.list, Object::NUMBER))
+	{
+		Object::List sorted = list.list;
+		sortRange(sorted.begin(), sorted.end(), [](Object const& first, Object const& second) { return numberBefore(first.number, second.number); });
+		return Object(std::move(sorted));
+	}
+	if (list.type == Object::LIST && allOfType(list.list, Object::PHRASE))
+	{
+		Object::List sorted = list.list;
+		sortRange(sorted.begin(), sorted.end(), [](Object const& first, Object const& second) { return first.phrase < second.phrase; });
+		return Object(std::move(sorted));
+	}
+	throw Mistake::Wrong_Type_Used("Could only sort a list of numbers or of phrases.");
+}
+
+BuiltinType::Object Library::contains(BuiltinType::Object const& container, BuiltinType::Object const& item)
+{
+	if (container.type == Object::NUMBER_LIST)
+	{
+		if (item.type != Object::NUMBER) return Object(false);
+		return Object(findInRange(container.numbers.begin(), container.numbers.end(), item.number) != container.numbers.end());
+	}
+	if (container.type == Object::LIST) return Object(findInRange(container.list.begin(), container.list.end(), item) != container.list.end());
+	if (container.type == Object::PHRASE && item.type == Object::PHRASE) return Object(container.phrase.find(item.phrase) != std::string::npos);
+	throw Mistake::Wrong_Type_Used("Could not look for a " + item.typeAsString() + " in a " + container.typeAsString());
+}
+
+BuiltinType::Object Library::reverse(BuiltinType::Object const& object)
+{
+	if (object.type == Object::NUMBER_LIST) return Object(Object::Numbers(object.numbers.rbegin(), object.numbers.rend()));
+	if (object.type == Object::LIST) return Object(Object::List(object.list.rbegin(), object.list.rend()));
+	if (object.type == Object::PHRASE) return Object(Object::Phrase(object.phrase.rbegin(), object.phrase.rend()));
+	throw Mistake::Wrong_Type_Used("Could not reverse a " + object.typeAsString());
+}
+
+BuiltinType::Object Library::readFile(BuiltinType::Object const& path)
+{
+	std::string const name = pathToRead(path);
+	flushWrites(name);
+	MappedFile const file(name);
+	return Object(Object::Phrase(file.data(), file.data() + file.size()));
+}
+
+BuiltinType::Object Library::readLines(BuiltinType::Object const& path)
+{
+	std::string const name = pathToRead(path);
+	flushWrites(name);
+	MappedFile const file(name);
+
+	Object::List lines;
+	char const* next = file.data();
+	char const* const last = file.data() + file.size();
+	while (next != last)
+	{
+		auto const line = takeLine(next, last);
+		lines.emplace_back(Object::Phrase(line.first, line.second));
+	}
+	return Object(std::move(lines));
+}
+
+BuiltinType::Object Library::writeFile(BuiltinType::Object const& path, BuiltinType::Object const& contents)
+{
+	if (path.type != Object::PHRASE) throw Mistake::Wrong_Type_Used("Could not write a file named by a " + path.typeAsString());
+	std::string_view const name(path.phrase.data(), path.phrase.size());
+	std::lock_guard<std::mutex> lock(writers().mutex);
+
+	auto found = writers().byPath.find(name);
+	if (found == writers().byPath.end())
+	{
+		std::string const newName(name);
+		found = writers().byPath.emplace(newName, std::make_unique<Writer>(newName)).first;
+	}
+
+	std::ofstream& stream = found->second->stream;
+	if (contents.type == Object::PHRASE) stream.write(contents.phrase.data(), static_cast<std::streamsize>(contents.phrase.size()));
+	else stream << contents;
+	if (!stream) throw Mistake::File_Does_Not_Exist("Could not write to " + found->first);
+	return Object();
+}
+
+Library::EachLine::EachLine(BuiltinType::Object const& path) :
+	file(nullptr),
+	next(nullptr),
+	last(nullptr),
+	givenBack(nullptr),
+	hasCurrent(false)
+{
+	std::string const name = pathToRead(path);
+	flushWrites(name);
+	file = std::make_unique<MappedFile>(name);
+	file->willReadInOrder();
+	givenBack = next = file->data();
+	last = file->data() + file->size();
+	load();
+}
+
+Library::EachLine::~EachLine() = default;
+
+// The phrase is refilled in place, so once it is as long as the longest line so far, reading a line allocates nothing.
+// Every so often the pages already gone over are given back, so only about that much of the file is ever held
+void Library::EachLine::load()
+{
+	std::size_t const giveBackEvery = 32 << 20;
+	hasCurrent = next != last;
+	if (!hasCurrent) return;
+
+	if (static_cast<std::size_t>(next - givenBack) >= giveBackEvery)
+	{
+		file->doneBefore(next - file->data());
+		givenBack = next;
+	}
+
+	auto const line = takeLine(next, last);
+	if (current.type == Object::PHRASE)
+	{
+		current.phrase.assign(line.first, line.second);
+		current.changedInPlace();
+	}
+	else current = Object(Object::Phrase(line.first, line.second));
+}
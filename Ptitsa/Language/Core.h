@@ -3,12 +3,22 @@
 
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <unordered_set>
+#include <initializer_list>
+#include <memory>
 #include "Object.h"
 
+class MappedFile;
+
 namespace Library
 {
 	using namespace BuiltinType;
 
+	// Where `show` writes, when not to std::cout. A parallel loop points it at a buffer of its own for each piece of the loop,
+	// so that what the iterations show comes out in the order of the list, as if they had run one after another
+	extern thread_local std::string* shownText;
+
 	inline void innerPrint(std::ostream& stream) {  }
 	template <typename T, typename... Rest> inline void innerPrint(std::ostream& stream, T const first, Rest const ...rest)
 	{
@@ -20,14 +30,161 @@ namespace Library
 		std::stringbuf buffer;
 		std::ostream stream(&buffer);
 		innerPrint(stream, first, rest...);
-		std::cout << buffer.str();
+		if (shownText) *shownText += buffer.str();
+		else std::cout << buffer.str();
 	}
 	template <typename T, typename... Rest> inline void showLine(T const first, Rest const ...rest) { show(first, rest..., "\n"); }
 
-	bool isTrue(const Object&);
-	bool isTrue(bool);
+	// Joining a chain of phrases (`a + " " + b + ...`) in one go, so that the result is allocated once.
+	// Falls back to the usual left-to-right `+` when any part turns out not to be a phrase.
+	inline bool isPhrase(Object const& object) { return object.type == Object::PHRASE; }
+	inline bool isPhrase(std::string const&) { return true; }
+	inline Object::Phrase const& phraseOf(Object const& object) { return object.phrase; }
+	inline std::string const& phraseOf(std::string const& string) { return string; }
+
+	template <typename... Parts> inline Object concatenate(Parts const& ...parts)
+	{
+		if ((isPhrase(parts) && ...))
+		{
+			Object::Phrase joined;
+			joined.reserve((phraseOf(parts).size() + ...));
+			(joined.append(phraseOf(parts).data(), phraseOf(parts).size()), ...);
+			return Object(std::move(joined));
+		}
+		return (... + parts);
+	}
+
+	// `x = x + y` done in place: lists are extended and phrases appended to with amortised O(1) growth.
+	// Anything else keeps the usual meaning of `+`. Numbers are added inline
+	PTITSA_COLD void addToInPlaceSlowly(Object& target, Object const& addition);
+	inline void addToInPlace(Object& target, Object const& addition)
+	{
+		if (PTITSA_LIKELY(target.type == Object::NUMBER && addition.type == Object::NUMBER)) target.number += addition.number;
+		else addToInPlaceSlowly(target, addition);
+	}
+	template <typename... Additions> inline void addInPlace(Object& target, Additions const& ...additions)
+	{
+		(addToInPlace(target, additions), ...);
+	}
+
+	// The literals in `x is a or b or c ...`, put together once so that testing x does not go through them one by one.
+	// Numbers are kept sorted and searched in halves, anything else is hashed. Matches exactly what `is` would
+	class Alternatives
+	{
+	public:
+		Alternatives(std::initializer_list<Object> alternatives);
+		bool contains(Object const& item) const;
+
+	private:
+		std::vector<double> numbers;
+		std::unordered_set<Object, ObjectHash, ObjectEquality> others;
+	};
+
+	[[noreturn]] PTITSA_COLD void notTrueOrFalse(Object const&);
+	inline bool isTrue(bool b) { return b; }
+	inline bool isTrue(Object const& object)
+	{
+		if (PTITSA_LIKELY(object.type == Object::BOOLEAN)) return object.boolean;
+		notTrueOrFalse(object);
+	}
 
 	Object exp(const Object&);
+
+	// `a to b`: the numbers from a up to b, counting in ones
+	Object range(const Object& first, const Object& last);
+
+	// `for each x in items`. x is a copy of each item in turn. When the body assigns to x, changesItems is true,
+	// and what the body leaves in x is put back in its place as the iteration ends, so assigning to x changes the list.
+	// Items the body adds to the end of the list are gone over too
+	class Each
+	{
+	public:
+		Each(Object& items, bool changesItems);
+		Each(Object const& items, bool changesItems); // worked out before the loop, so there is no list to put items back into
+		Each(Object&& items, bool changesItems);
+		Each(Each const&) = delete;
+		Each& operator=(Each const&) = delete;
+
+		class Iterator
+		{
+		public:
+			explicit Iterator(Each& each) : each(each) { }
+			Object& operator*() const { return each.current; }
+			Iterator& operator++() { each.next(); return *this; }
+			bool operator!=(Iterator const&) const { return each.hasCurrent(); }
+
+		private:
+			Each& each;
+		};
+
+		Iterator begin();
+		Iterator end() { return Iterator(*this); }
+
+	private:
+		Object owned;
+		Object& items;
+		Object current;
+		std::size_t index;
+		bool const changesItems;
+
+		bool hasCurrent() const { return items.isList() && index < items.listSize(); }
+		void load();
+		void putBack();
+		void next();
+	};
+
+	// List builtins. On large lists, sort and contains use the parallel algorithms when the runtime is built with them.
+	// sum does not, so that a list always adds up to the same total
+	Object length(const Object&);
+	Object sum(const Object&);
+	Object max(const Object&);
+	Object sort(const Object&);
+	Object contains(const Object& container, const Object& item);
+	Object reverse(const Object&);
+
+	// File builtins. Files are mapped into memory to be read, so nothing is read until it is used.
+	// `write file` buffers what it writes: the first write to a file in a run replaces it, and later ones add to the end,
+	// so a program can write a file a line at a time. Everything is written by the time the program ends
+	Object readFile(const Object& path);
+	Object readLines(const Object& path); // a list of phrases, one per line, without the line endings
+	Object writeFile(const Object& path, const Object& contents);
+
+	// `for each line in read lines path`. The lines are read one at a time straight from the mapped file,
+	// into a phrase used again for every line, so a file of any size is gone over without being held in memory.
+	// There is no list, so what the body leaves in the variable is not put back anywhere
+	class EachLine
+	{
+	public:
+		explicit EachLine(Object const& path);
+		EachLine(EachLine const&) = delete;
+		EachLine& operator=(EachLine const&) = delete;
+		~EachLine();
+
+		class Iterator
+		{
+		public:
+			explicit Iterator(EachLine& each) : each(each) { }
+			Object& operator*() const { return each.current; }
+			Iterator& operator++() { each.load(); return *this; }
+			bool operator!=(Iterator const&) const { return each.hasCurrent; }
+
+		private:
+			EachLine& each;
+		};
+
+		Iterator begin() { return Iterator(*this); }
+		Iterator end() { return Iterator(*this); }
+
+	private:
+		std::unique_ptr<MappedFile> file;
+		char const* next;
+		char const* last;
+		char const* givenBack; // the pages before here have been given back
+		Object current;
+		bool hasCurrent;
+
+		void load();
+	};
 }
 
 #endif // !CORE_INCLUDE
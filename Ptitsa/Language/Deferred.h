@@ -0,0 +1,31 @@
+#ifndef DEFERRED_INCLUDE
+#define DEFERRED_INCLUDE
+
+#include <optional>
+#include "Object.h"
+
+namespace BuiltinType
+{
+	// A value worked out the first time it is read with `*`, and kept after that.
+	// Expressions that do not change inside a loop are moved out into one of these,
+	// so they are worked out once, and not at all if the loop never needs them
+	template <typename Compute> class Deferred
+	{
+	public:
+		explicit Deferred(Compute compute) : compute(compute) { }
+		Deferred(Deferred const &) = delete;
+		Deferred & operator=(Deferred const &) = delete;
+
+		Object const & operator*() const
+		{
+			if (!value) value.emplace(compute());
+			return *value;
+		}
+
+	private:
+		Compute compute;
+		mutable std::optional<Object> value;
+	};
+}
+
+#endif // !DEFERRED_INCLUDE
@@ -0,0 +1,128 @@
+#ifndef EXPRESSION_INCLUDE
+#define EXPRESSION_INCLUDE
+
+#include <cmath>
+#include "Object.h"
+
+// Arithmetic is built lazily as a tree of expression nodes, e.g. `a * b + c` becomes Add(Multiply(a, b), c),
+// and is only turned into an Object when it is assigned. If every leaf is a number the whole tree is worked out
+// on doubles, so no Objects are made for the intermediate results.
+// Otherwise the tree falls back to the usual Object operators, in the same order.
+
+namespace BuiltinType
+{
+	template <typename Derived> struct Expression
+	{
+		Derived const& self() const { return static_cast<Derived const&>(*this); }
+
+		operator Object() const
+		{
+			double result;
+			if (self().couldEvaluateNumber(result)) return Object(result);
+			return self().evaluate();
+		}
+	};
+
+	struct Operand : Expression<Operand>
+	{
+		Object const& object;
+
+		explicit Operand(Object const& object) : object(object) { }
+
+		bool couldEvaluateNumber(double& result) const
+		{
+			if (object.type != Object::NUMBER) return false;
+			result = object.number;
+			return true;
+		}
+		Object evaluate() const { return object; }
+	};
+
+	struct Constant : Expression<Constant>
+	{
+		double value;
+
+		explicit Constant(double value) : value(value) { }
+
+		bool couldEvaluateNumber(double& result) const
+		{
+			result = value;
+			return true;
+		}
+		Object evaluate() const { return Object(value); }
+	};
+
+	// Leaves are passed on without copying when falling back to the Object operators
+	inline Object const& materialise(Operand const& operand) { return operand.object; }
+	template <typename Derived> inline Object materialise(Expression<Derived> const& expression) { return expression.self().evaluate(); }
+
+	template <typename Operation, typename Left, typename Right> struct Binary : Expression<Binary<Operation, Left, Right>>
+	{
+		Left const left;
+		Right const right;
+
+		Binary(Left const& left, Right const& right) : left(left), right(right) { }
+
+		bool couldEvaluateNumber(double& result) const
+		{
+			double leftNumber, rightNumber;
+			if (!left.couldEvaluateNumber(leftNumber) || !right.couldEvaluateNumber(rightNumber)) return false;
+			result = Operation::apply(leftNumber, rightNumber);
+			return true;
+		}
+		Object evaluate() const { return Operation::apply(materialise(left), materialise(right)); }
+	};
+
+	struct Add
+	{
+		static double apply(double first, double second) { return first + second; }
+		static Object apply(Object const& first, Object const& second) { return first + second; }
+	};
+	struct Subtract
+	{
+		static double apply(double first, double second) { return first - second; }
+		static Object apply(Object const& first, Object const& second) { return first - second; }
+	};
+	struct Multiply
+	{
+		static double apply(double first, double second) { return first * second; }
+		static Object apply(Object const& first, Object const& second) { return first * second; }
+	};
+	struct Divide
+	{
+		static double apply(double first, double second) { return first / second; }
+		static Object apply(Object const& first, Object const& second) { return first / second; }
+	};
+	struct Power
+	{
+		static double apply(double first, double second) { return pow(first, second); }
+		static Object apply(Object const& first, Object const& second) { return first ^ second; }
+	};
+
+	inline Operand lazy(Object const& object) { return Operand(object); }
+	inline Constant lazy(double value) { return Constant(value); }
+	Constant lazy(bool) = delete; // would otherwise silently become 0 or 1
+
+	template <typename L, typename R> inline Binary<Add, L, R> operator+(Expression<L> const& first, Expression<R> const& second)
+	{
+		return Binary<Add, L, R>(first.self(), second.self());
+	}
+	template <typename L, typename R> inline Binary<Subtract, L, R> operator-(Expression<L> const& first, Expression<R> const& second)
+	{
+		return Binary<Subtract, L, R>(first.self(), second.self());
+	}
+	template <typename L, typename R> inline Binary<Multiply, L, R> operator*(Expression<L> const& first, Expression<R> const& second)
+	{
+		return Binary<Multiply, L, R>(first.self(), second.self());
+	}
+	template <typename L, typename R> inline Binary<Divide, L, R> operator/(Expression<L> const& first, Expression<R> const& second)
+	{
+		return Binary<Divide, L, R>(first.self(), second.self());
+	}
+	template <typename L, typename R> inline Binary<Power, L, R> operator^(Expression<L> const& first, Expression<R> const& second)
+	{
+		return Binary<Power, L, R>(first.self(), second.self());
+	}
+}
+
+#endif // !EXPRESSION_INCLUDE
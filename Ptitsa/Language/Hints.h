@@ -0,0 +1,16 @@
+#ifndef HINTS_INCLUDE
+#define HINTS_INCLUDE
+
+// Hints to the compiler about which way the runtime's branches usually go. [[likely]] is C++20, and the runtime is C++17.
+// PTITSA_COLD marks a function that is rarely called: it is never inlined, and is laid out away from the code that calls it
+#if defined(__GNUC__) || defined(__clang__)
+#define PTITSA_LIKELY(condition) __builtin_expect(!!(condition), 1)
+#define PTITSA_UNLIKELY(condition) __builtin_expect(!!(condition), 0)
+#define PTITSA_COLD [[gnu::cold, gnu::noinline]]
+#else
+#define PTITSA_LIKELY(condition) (condition)
+#define PTITSA_UNLIKELY(condition) (condition)
+#define PTITSA_COLD __declspec(noinline)
+#endif
+
+#endif // !HINTS_INCLUDE
@@ -0,0 +1,97 @@
+#include <cstring>
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "Kernels.h"
+
+bool Kernels::equal(double const* first, double const* second, std::size_t size)
+{
+	std::size_t i = 0;
+#if defined(__AVX2__)
+	for (; i + 4 <= size; i += 4)
+	{
+		__m256d const same = _mm256_cmp_pd(_mm256_loadu_pd(first + i), _mm256_loadu_pd(second + i), _CMP_EQ_OQ);
+		if (_mm256_movemask_pd(same) != 0xF) return false;
+	}
+#elif defined(__SSE2__)
+	for (; i + 2 <= size; i += 2)
+	{
+		__m128d const same = _mm_cmpeq_pd(_mm_loadu_pd(first + i), _mm_loadu_pd(second + i));
+		if (_mm_movemask_pd(same) != 0x3) return false;
+	}
+#endif
+	for (; i < size; ++i)
+	{
+		if (first[i] != second[i]) return false; // `!=` rather than memcmp, so that 0 equals -0 and NaN equals nothing
+	}
+	return true;
+}
+
+namespace
+{
+	// The eight running totals of sum, put together pairwise in the order the AVX2 lanes are
+	double combined(double const* totals)
+	{
+		return ((totals[0] + totals[4]) + (totals[1] + totals[5])) + ((totals[2] + totals[6]) + (totals[3] + totals[7]));
+	}
+}
+
+double Kernels::sum(double const* numbers, std::size_t size)
+{
+	std::size_t i = 0;
+	double totals[8];
+#if defined(__AVX2__)
+	__m256d firstTotals = _mm256_setzero_pd(), secondTotals = _mm256_setzero_pd();
+	for (; i + 8 <= size; i += 8)
+	{
+		firstTotals = _mm256_add_pd(firstTotals, _mm256_loadu_pd(numbers + i));
+		secondTotals = _mm256_add_pd(secondTotals, _mm256_loadu_pd(numbers + i + 4));
+	}
+	_mm256_storeu_pd(totals, firstTotals);
+	_mm256_storeu_pd(totals + 4, secondTotals);
+#elif defined(__SSE2__)
+	__m128d totals01 = _mm_setzero_pd(), totals23 = _mm_setzero_pd(), totals45 = _mm_setzero_pd(), totals67 = _mm_setzero_pd();
+	for (; i + 8 <= size; i += 8)
+	{
+		totals01 = _mm_add_pd(totals01, _mm_loadu_pd(numbers + i));
+		totals23 = _mm_add_pd(totals23, _mm_loadu_pd(numbers + i + 2));
+		totals45 = _mm_add_pd(totals45, _mm_loadu_pd(numbers + i + 4));
+		totals67 = _mm_add_pd(totals67, _mm_loadu_pd(numbers + i + 6));
+	}
+	_mm_storeu_pd(totals, totals01);
+	_mm_storeu_pd(totals + 2, totals23);
+	_mm_storeu_pd(totals + 4, totals45);
+	_mm_storeu_pd(totals + 6, totals67);
+#else
+	for (unsigned j = 0; j < 8; ++j) totals[j] = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		for (unsigned j = 0; j < 8; ++j) totals[j] += numbers[i + j];
+	}
+#endif
+	double total = combined(totals);
+	for (; i < size; ++i) total += numbers[i];
+	return total;
+}
+
+double Kernels::Sum::total() const
+{
+	double total = combined(totals);
+	for (unsigned j = 0; j < count; ++j) total += waiting[j];
+	return total;
+}
+
+// Kept as a plain loop so that each element matches Library::exp on a single number exactly
+void Kernels::exp(double const* powers, double* results, std::size_t size)
+{
+	for (std::size_t i = 0; i < size; ++i) results[i] = pow(2.71828182845904523536, powers[i]);
+}
+
+void Kernels::repeat(double const* numbers, std::size_t size, double* results, std::size_t times)
+{
+	if (size == 0) return;
+	for (std::size_t t = 0; t < times; ++t) std::memcpy(results + t * size, numbers, size * sizeof(double));
+}
@@ -0,0 +1,35 @@
+#ifndef KERNELS_INCLUDE
+#define KERNELS_INCLUDE
+
+#include <cstddef>
+
+// Loops over the contiguous doubles of a number list. Uses AVX2 or SSE2 when the runtime is compiled for them
+namespace Kernels
+{
+	bool equal(double const* first, double const* second, std::size_t size);
+	double sum(double const* numbers, std::size_t size);
+	void exp(double const* powers, double* results, std::size_t size);
+	void repeat(double const* numbers, std::size_t size, double* results, std::size_t times);
+
+	// Adds numbers up one at a time in the order sum does: eight running totals, one for each place modulo 8, put together
+	// pairwise, and then the numbers after the last whole eight in turn. So a list adds up the same however it is stored
+	class Sum
+	{
+	public:
+		void add(double number)
+		{
+			waiting[count++] = number;
+			if (count < 8) return;
+			for (unsigned j = 0; j < 8; ++j) totals[j] += waiting[j];
+			count = 0;
+		}
+		double total() const;
+
+	private:
+		double totals[8] = { };
+		double waiting[8];
+		unsigned count = 0;
+	};
+}
+
+#endif // !KERNELS_INCLUDE
@@ -0,0 +1,267 @@
+// Only built into a runtime built with PTITSA_TRACK_MEMORY, so a program compiled with --track-memory fails to link against any other
+#ifdef PTITSA_TRACK_MEMORY
+
+#include <vector>
+#include <unordered_map>
+#include <memory_resource>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+#include "Memory.h"
+#include "Object.h"
+
+thread_local unsigned Library::Memory::currentRow = 0;
+
+namespace
+{
+	using Library::Memory::EVENTS;
+	using BuiltinType::Object;
+
+	unsigned const objectTypes = Object::NUMBER_LIST + 1;
+	char const * const typeNames[objectTypes] = { "Nothing", "Number", "Phrase", "Boolean", "List", "Number list" };
+
+	struct LineCounts
+	{
+		unsigned long long events[objectTypes][EVENTS] = { };
+	};
+
+	struct LineBytes
+	{
+		long long held = 0; // can go below 0 on a line, when it frees what another line allocated
+		unsigned long long allocated = 0;
+		unsigned long long allocations = 0;
+		bool changed = false; // since heldAtPeak was last brought up to date
+	};
+
+	double kilobytes(long long bytes) { return bytes / 1024.0; }
+
+	// Wraps the default resource, so every phrase and list allocates through it. Which line allocated each block is kept,
+	// so that freeing it is put down to the same line. Whenever the total held passes its peak, what each line holds is copied out.
+	// Only the lines that have changed since the last copy are copied, so a program that keeps growing is not slowed by its number of lines
+	class Tracker : public std::pmr::memory_resource
+	{
+	public:
+		explicit Tracker(std::pmr::memory_resource * upstream) : upstream(upstream) { }
+
+		std::mutex mutex; // for what follows
+		std::vector<LineBytes> lines;
+		long long held = 0, peak = 0;
+		std::vector<long long> heldAtPeak;
+
+	private:
+		struct Allocation
+		{
+			unsigned row;
+			std::size_t bytes;
+		};
+
+		std::pmr::memory_resource * const upstream;
+		std::unordered_map<void *, Allocation> allocations;
+		std::vector<unsigned> changedRows;
+
+		void change(unsigned row, long long bytes)
+		{
+			lines[row].held += bytes;
+			held += bytes;
+			if (!lines[row].changed)
+			{
+				lines[row].changed = true;
+				changedRows.push_back(row);
+			}
+		}
+
+		void * do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			void * const allocated = upstream->allocate(bytes, alignment);
+			unsigned const row = Library::Memory::currentRow;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			allocations[allocated] = { row, bytes };
+			if (row >= lines.size()) lines.resize(row + 1);
+			lines[row].allocated += bytes;
+			lines[row].allocations++;
+			change(row, static_cast<long long>(bytes));
+
+			if (held > peak)
+			{
+				peak = held;
+				heldAtPeak.resize(lines.size());
+				for (unsigned changedRow : changedRows)
+				{
+					heldAtPeak[changedRow] = lines[changedRow].held;
+					lines[changedRow].changed = false;
+				}
+				changedRows.clear();
+			}
+			return allocated;
+		}
+
+		void do_deallocate(void * allocated, std::size_t bytes, std::size_t alignment) override
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto const found = allocations.find(allocated);
+				if (found != allocations.end()) // else allocated before counting started
+				{
+					change(found->second.row, -static_cast<long long>(found->second.bytes));
+					allocations.erase(found);
+				}
+			}
+			upstream->deallocate(allocated, bytes, alignment);
+		}
+
+		bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override { return this == &other; }
+	};
+
+	// Made before anything is counted, so it is destroyed after every thread's counts have been added in.
+	// The Tracker is never destroyed, as phrases and lists in static Objects still free through it after the report
+	struct Report
+	{
+		std::string sourceName;
+		Tracker * tracker = nullptr;
+
+		std::mutex mutex;
+		std::vector<LineCounts> lines;
+
+		~Report()
+		{
+			if (!tracker) return;
+			std::lock_guard<std::mutex> lock(tracker->mutex);
+			std::ostream & out = std::cerr;
+
+			LineCounts total;
+			std::vector<unsigned> rows;
+			for (unsigned row = 0; row < std::max(lines.size(), tracker->lines.size()); row++)
+			{
+				bool used = row < tracker->lines.size() && tracker->lines[row].allocations > 0;
+				for (unsigned type = 0; row < lines.size() && type < objectTypes; type++)
+				{
+					for (unsigned event = 0; event < EVENTS; event++)
+					{
+						total.events[type][event] += lines[row].events[type][event];
+						used = used || lines[row].events[type][event] > 0;
+					}
+				}
+				if (used) rows.push_back(row);
+			}
+			lines.resize(std::max(lines.size(), tracker->lines.size()));
+			tracker->lines.resize(lines.size());
+			tracker->heldAtPeak.resize(lines.size());
+
+			// Copies of phrases and lists are the ones that copy what they hold
+			auto const deepCopies = [this](unsigned row)
+			{
+				return lines[row].events[Object::PHRASE][Library::Memory::COPIED] + lines[row].events[Object::LIST][Library::Memory::COPIED]
+					+ lines[row].events[Object::NUMBER_LIST][Library::Memory::COPIED];
+			};
+			std::sort(rows.begin(), rows.end(), [&](unsigned first, unsigned second)
+			{
+				if (tracker->heldAtPeak[first] != tracker->heldAtPeak[second]) return tracker->heldAtPeak[first] > tracker->heldAtPeak[second];
+				if (tracker->lines[first].allocated != tracker->lines[second].allocated) return tracker->lines[first].allocated > tracker->lines[second].allocated;
+				return deepCopies(first) > deepCopies(second);
+			});
+
+			out << "\nMemory of " << sourceName << ": " << std::fixed << std::setprecision(1) << kilobytes(tracker->peak)
+				<< " KB held by phrases and lists at the peak, " << kilobytes(tracker->held) << " KB still held at the end\n";
+			out << std::setw(12) << "objects" << std::setw(14) << "made" << std::setw(14) << "copied" << std::setw(14) << "moved" << std::setw(14) << "destroyed" << "\n";
+			for (unsigned type = 0; type < objectTypes; type++)
+			{
+				out << std::setw(12) << typeNames[type];
+				for (unsigned event = 0; event < EVENTS; event++) out << std::setw(14) << total.events[type][event];
+				out << "\n";
+			}
+
+			// Line 0 is what ran outside any line, like the phrases made when the program starts
+			out << "\nLines by what they held when the total held was at its peak, then by what they allocated\n";
+			out << std::setw(8) << "line" << std::setw(14) << "peak (KB)" << std::setw(16) << "allocated (KB)" << std::setw(13) << "allocations"
+				<< std::setw(12) << "made" << std::setw(12) << "copied" << std::setw(14) << "deep copies" << std::setw(12) << "moved" << std::setw(12) << "destroyed" << "\n";
+			for (unsigned row : rows)
+			{
+				unsigned long long events[EVENTS] = { };
+				for (unsigned type = 0; type < objectTypes; type++)
+				{
+					for (unsigned event = 0; event < EVENTS; event++) events[event] += lines[row].events[type][event];
+				}
+				out << std::setw(8) << row << std::setw(14) << kilobytes(tracker->heldAtPeak[row]) << std::setw(16) << kilobytes(tracker->lines[row].allocated)
+					<< std::setw(13) << tracker->lines[row].allocations << std::setw(12) << events[Library::Memory::MADE] << std::setw(12) << events[Library::Memory::COPIED]
+					<< std::setw(14) << deepCopies(row) << std::setw(12) << events[Library::Memory::MOVED] << std::setw(12) << events[Library::Memory::DESTROYED] << "\n";
+			}
+		}
+	};
+
+	Report & report()
+	{
+		static Report report;
+		return report;
+	}
+
+	// The report is made by the first count, so it outlives every Object counted, even one made before main. A thread's own counts do not:
+	// the main thread's are merged before the program's static Objects are destroyed, so those are counted in the report itself
+	thread_local bool countsMerged = false;
+
+	// Where this thread's counts are, kept apart from them as a thread_local that needs making is checked for being made on every use
+	thread_local LineCounts * ownLines = nullptr;
+	thread_local std::size_t ownRows = 0;
+
+	struct ThreadCounts
+	{
+		std::vector<LineCounts> lines;
+
+		ThreadCounts() { report(); }
+
+		~ThreadCounts()
+		{
+			Report & total = report();
+			std::lock_guard<std::mutex> lock(total.mutex);
+			countsMerged = true;
+			ownRows = 0;
+			if (total.lines.size() < lines.size()) total.lines.resize(lines.size());
+			for (std::size_t row = 0; row < lines.size(); row++)
+			{
+				for (unsigned type = 0; type < objectTypes; type++)
+				{
+					for (unsigned event = 0; event < EVENTS; event++) total.lines[row].events[type][event] += lines[row].events[type][event];
+				}
+			}
+		}
+	};
+
+	thread_local ThreadCounts threadCounts;
+
+	// The first count on a thread, or on a line further down than any it counted before
+	PTITSA_COLD void countSlowly(Library::Memory::Event event, unsigned objectType)
+	{
+		using Library::Memory::currentRow;
+		if (countsMerged)
+		{
+			Report & total = report();
+			std::lock_guard<std::mutex> lock(total.mutex);
+			if (currentRow >= total.lines.size()) total.lines.resize(currentRow + 1);
+			total.lines[currentRow].events[objectType][event]++;
+			return;
+		}
+		std::vector<LineCounts> & lines = threadCounts.lines;
+		if (currentRow >= lines.size()) lines.resize(currentRow + 1);
+		ownLines = lines.data();
+		ownRows = lines.size();
+		lines[currentRow].events[objectType][event]++;
+	}
+}
+
+void Library::Memory::start(std::string const & sourceName)
+{
+	Report & total = report();
+	total.sourceName = sourceName;
+	total.tracker = new Tracker(std::pmr::get_default_resource());
+	std::pmr::set_default_resource(total.tracker);
+}
+
+void Library::Memory::count(Library::Memory::Event event, unsigned objectType)
+{
+	if (PTITSA_LIKELY(currentRow < ownRows)) ownLines[currentRow].events[objectType][event]++;
+	else countSlowly(event, objectType);
+}
+
+#endif // PTITSA_TRACK_MEMORY
@@ -0,0 +1,43 @@
+#ifndef MEMORY_INCLUDE
+#define MEMORY_INCLUDE
+
+#include <string>
+
+// Used by programs compiled with --track-memory, which have to be built, runtime and all, with PTITSA_TRACK_MEMORY defined.
+// Every Object made, copied, moved and destroyed is counted by its type, and every byte phrases and lists allocate is counted too,
+// all against the line of the source being run. Counts are kept per thread, so counting never waits on a lock; the bytes are not,
+// as a list may be freed on another thread than made it.
+// When the program ends, the counts and the lines holding the most memory at its peak are written to std::cerr
+
+namespace Library
+{
+	namespace Memory
+	{
+		enum Event { MADE, COPIED, MOVED, DESTROYED, EVENTS };
+
+		// Starts counting the bytes phrases and lists allocate, from the default memory resource, which may be an Arena's.
+		// Objects are counted from the start of the program
+		void start(std::string const & sourceName);
+
+		void count(Event event, unsigned objectType);
+
+		// The line of the source this thread is running, or 0 outside any
+		extern thread_local unsigned currentRow;
+
+		// Made before each statement: what happens until the end of its scope is put down to its line,
+		// except while a later statement's Line is alive
+		class Line
+		{
+		public:
+			explicit Line(unsigned row) : previous(currentRow) { currentRow = row; }
+			Line(Line const &) = delete;
+			Line & operator=(Line const &) = delete;
+			~Line() { currentRow = previous; }
+
+		private:
+			unsigned const previous;
+		};
+	}
+}
+
+#endif // !MEMORY_INCLUDE
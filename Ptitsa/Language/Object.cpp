@@ -1,9 +1,15 @@
 #include <string>
+#include <string_view>
+#include <iterator>
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <functional>
+#include <unordered_set>
+#include <mutex>
 
 #include "Object.h"
+#include "Kernels.h"
 #include "../Compiler/Util.h"
 #include "../Compiler/Mistake.h"
 
@@ -11,44 +17,103 @@
 
 using namespace BuiltinType;
 
-Object::Object()
-{
-	new (&boolean) bool(true);
-	type = NOTHING;
-}
-Object::Object(double d)
-{
-	new (&number) double(d);
-	type = NUMBER;
-}
 Object::Object(std::string const& string)
 {
-	new (&phrase) std::string(string);
+	new (&phrase) Phrase(string.begin(), string.end());
 	type = PHRASE;
+	PTITSA_TRACK(MADE, PHRASE);
 }
 Object::Object(std::string&& string)
 {
-	new (&phrase) std::string();
-	std::swap(phrase, string);
+	new (&phrase) Phrase(string.begin(), string.end());
 	type = PHRASE;
+	PTITSA_TRACK(MADE, PHRASE);
 }
-Object::Object(bool b)
+Object::Object(Phrase&& string)
 {
-	new (&boolean) bool(b);
-	type = BOOLEAN;
+	new (&phrase) Phrase(std::move(string));
+	type = PHRASE;
+	PTITSA_TRACK(MADE, PHRASE);
 }
+namespace
+{
+	template <typename Vector> bool allNumbers(Vector const& vector)
+	{
+		for (Object const& element : vector)
+		{
+			if (element.type != Object::NUMBER) return false;
+		}
+		return true;
+	}
+
+	template <typename Vector> Object::Numbers numbersOf(Vector const& vector)
+	{
+		Object::Numbers numbers;
+		numbers.reserve(vector.size());
+		for (Object const& element : vector) numbers.push_back(element.number);
+		return numbers;
+	}
+}
+
 Object::Object(std::vector<Object>&& vector)
 {
-	new (&list) std::vector<Object>();
-	std::swap(list, vector);
+	if (allNumbers(vector))
+	{
+		new (&numbers) Numbers(numbersOf(vector));
+		type = NUMBER_LIST;
+		PTITSA_TRACK(MADE, NUMBER_LIST);
+		return;
+	}
+	new (&list) List(std::make_move_iterator(vector.begin()), std::make_move_iterator(vector.end()));
 	type = LIST;
+	PTITSA_TRACK(MADE, LIST);
 }
 Object::Object(std::vector<Object> const& vector)
 {
-	new (&list) std::vector<Object>(vector);
+	if (allNumbers(vector))
+	{
+		new (&numbers) Numbers(numbersOf(vector));
+		type = NUMBER_LIST;
+		PTITSA_TRACK(MADE, NUMBER_LIST);
+		return;
+	}
+	new (&list) List(vector.begin(), vector.end());
 	type = LIST;
+	PTITSA_TRACK(MADE, LIST);
 }
-Object::Object(const Object& other)
+Object::Object(List&& vector)
+{
+	if (allNumbers(vector))
+	{
+		new (&numbers) Numbers(numbersOf(vector));
+		type = NUMBER_LIST;
+		PTITSA_TRACK(MADE, NUMBER_LIST);
+		return;
+	}
+	new (&list) List(std::move(vector));
+	type = LIST;
+	PTITSA_TRACK(MADE, LIST);
+}
+Object::Object(std::vector<double>&& vector)
+{
+	new (&numbers) Numbers(vector.begin(), vector.end());
+	type = NUMBER_LIST;
+	PTITSA_TRACK(MADE, NUMBER_LIST);
+}
+Object::Object(std::vector<double> const& vector)
+{
+	new (&numbers) Numbers(vector.begin(), vector.end());
+	type = NUMBER_LIST;
+	PTITSA_TRACK(MADE, NUMBER_LIST);
+}
+Object::Object(Numbers&& vector)
+{
+	new (&numbers) Numbers(std::move(vector));
+	type = NUMBER_LIST;
+	PTITSA_TRACK(MADE, NUMBER_LIST);
+}
+// Expects this Object's storage to be unconstructed, as initAndSwapWith does
+void Object::initAsCopyOf(Object const& other)
 {
 	switch (other.type)
 	{
@@ -56,59 +121,84 @@ Object::Object(const Object& other)
 			new (&number) double(other.number);			
 			break;
 		case PHRASE:	
-			new (&phrase) std::string(other.phrase);	
+			new (&phrase) Phrase(other.phrase);	
 			break;
 		case BOOLEAN:
 			new (&boolean) bool(other.boolean);
 			break;
 		case LIST:
-			new (&list) std::vector<Object>(other.list);
+			new (&list) List(other.list);
+			break;
+		case NUMBER_LIST:
+			new (&numbers) Numbers(other.numbers);
 			break;
 	}
 	type = other.type;
-}
-Object::Object(Object&& temp)
-{
-	initAndSwapWith(temp);	
+	interned = other.interned;
+	bool const known = other.hashKnown.load(std::memory_order_acquire);
+	hash.store(other.hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	hashKnown.store(known, std::memory_order_relaxed);
 }
 
-Object::~Object()
+void Object::wipe()
 {
 	if (type == PHRASE) phrase.~basic_string();
 	else if (type == LIST) list.~vector();
+	else if (type == NUMBER_LIST) numbers.~Numbers();
+	type = NOTHING; // so that the destructor does not free it again
+	interned = nullptr;
+	hashKnown.store(false, std::memory_order_relaxed);
 }
 
-void Object::wipe()
+void Object::changedInPlace()
 {
-	if (type == PHRASE) phrase.~basic_string();
-	else if (type == LIST) list.~vector();
+	interned = nullptr;
+	hashKnown.store(false, std::memory_order_relaxed);
 }
 
+// Expects this Object's storage to be unconstructed, i.e. freshly allocated or wiped
 void Object::initAndSwapWith(Object& other)
 {
 	switch (other.type)
 	{
 		case PHRASE:	
-			phrase = "";
-			std::swap(phrase, other.phrase);
+			new (&phrase) Phrase(std::move(other.phrase));
 			break;
 		case NUMBER:
-			number = 0;
-			std::swap(number, other.number);
+			new (&number) double(other.number);
 			break;
 		case BOOLEAN:
-			boolean = false;
-			std::swap(boolean, other.boolean);
+			new (&boolean) bool(other.boolean);
 			break;
 		case LIST:
-			list = std::vector<Object>();
-			std::swap(list, other.list);
+			new (&list) List(std::move(other.list));
+			break;
+		case NUMBER_LIST:
+			new (&numbers) Numbers(std::move(other.numbers));
 			break;
 	}
 	type = other.type;
+	interned = other.interned;
+	bool const known = other.hashKnown.load(std::memory_order_acquire);
+	hash.store(other.hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	hashKnown.store(known, std::memory_order_relaxed);
 	other.wipe();
 }
 
+bool Object::isList() const { return type == LIST || type == NUMBER_LIST; }
+
+std::size_t Object::listSize() const { return type == NUMBER_LIST ? numbers.size() : list.size(); }
+
+void Object::promoteToList()
+{
+	if (type != NUMBER_LIST) return;
+
+	List elements(numbers.begin(), numbers.end());
+	numbers.~Numbers();
+	new (&list) List(std::move(elements));
+	type = LIST;
+}
+
 std::string Object::typeAsString() const
 {
 	switch (type)
@@ -120,6 +210,7 @@ std::string Object::typeAsString() const
 		case BOOLEAN:
 			return "Boolean";
 		case LIST:
+		case NUMBER_LIST:
 			return "List";
 		case NOTHING:
 			return "Nothing";
@@ -129,8 +220,52 @@ std::string Object::typeAsString() const
 
 
 
-bool BuiltinType::areEqual(const Object& first, const Object& second)
+namespace
 {
+	bool numberListsEqual(Object const& numberList, Object const& list)
+	{
+		if (numberList.numbers.size() != list.list.size()) return false;
+
+		for (std::size_t i = 0; i < list.list.size(); ++i)
+		{
+			if (list.list[i].type != Object::NUMBER || list.list[i].number != numberList.numbers[i]) return false;
+		}
+		return true;
+	}
+
+	// Threads working out the same hash at once store the same value, and hashKnown is only seen set once the hash is
+	template <typename Work> std::size_t cachedHash(Object const& object, Work const& work)
+	{
+		if (object.hashKnown.load(std::memory_order_acquire)) return object.hash.load(std::memory_order_relaxed);
+
+		std::size_t const hash = work();
+		object.hash.store(hash, std::memory_order_relaxed);
+		object.hashKnown.store(true, std::memory_order_release);
+		return hash;
+	}
+
+	// Only hashes already worked out are compared: working them out costs as much as comparing
+	bool hashesDiffer(Object const& first, Object const& second)
+	{
+		return first.hashKnown.load(std::memory_order_acquire) && second.hashKnown.load(std::memory_order_acquire)
+			&& first.hash.load(std::memory_order_relaxed) != second.hash.load(std::memory_order_relaxed);
+	}
+
+	std::size_t numberHash(double number)
+	{
+		std::size_t const typeHash = static_cast<std::size_t>(Object::NUMBER) * 0x9e3779b97f4a7c15;
+		return typeHash ^ std::hash<double>()(number == 0 ? 0.0 : number); // 0 and -0 are equal
+	}
+}
+
+bool BuiltinType::areEqualSlowly(const Object& first, const Object& second)
+{
+	if (first.isList() && second.isList() && first.type != second.type) // same list, stored either way
+	{
+		if (hashesDiffer(first, second)) return false;
+		return first.type == Object::NUMBER_LIST ? numberListsEqual(first, second) : numberListsEqual(second, first);
+	}
+
 	if (first.type == second.type)
 	{
 		switch (first.type)
@@ -138,11 +273,17 @@ bool BuiltinType::areEqual(const Object& first, const Object& second)
 		case Object::NUMBER:
 			return first.number == second.number;
 		case Object::PHRASE:
+			if (first.interned && second.interned) return first.interned == second.interned;
+			if (hashesDiffer(first, second)) return false;
 			return first.phrase == second.phrase;
 		case Object::BOOLEAN:
 			return first.boolean == second.boolean;
 		case Object::LIST:
+			if (hashesDiffer(first, second)) return false;
 			return first.list == second.list;
+		case Object::NUMBER_LIST:
+			if (hashesDiffer(first, second)) return false;
+			return first.numbers.size() == second.numbers.size() && Kernels::equal(first.numbers.data(), second.numbers.data(), first.numbers.size());
 		case Object::NOTHING:
 			return true;
 		default:
@@ -150,4 +291,58 @@ bool BuiltinType::areEqual(const Object& first, const Object& second)
 		}
 	}
 	else return false;
+}
+
+std::size_t BuiltinType::hashOf(Object const& object)
+{
+	std::size_t const typeHash = static_cast<std::size_t>(object.type) * 0x9e3779b97f4a7c15;
+
+	switch (object.type)
+	{
+	case Object::NUMBER:
+		return numberHash(object.number);
+	case Object::PHRASE:
+		return cachedHash(object, [&] { return typeHash ^ std::hash<std::string_view>()(object.phrase); });
+	case Object::BOOLEAN:
+		return typeHash ^ std::hash<bool>()(object.boolean);
+	case Object::LIST:
+		return cachedHash(object, [&]
+		{
+			std::size_t hash = typeHash ^ object.list.size();
+			for (Object const& element : object.list)
+			{
+				hash ^= hashOf(element) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+			}
+			return hash;
+		});
+	case Object::NUMBER_LIST: // hashed as the LIST it is equal to
+		return cachedHash(object, [&]
+		{
+			std::size_t hash = (static_cast<std::size_t>(Object::LIST) * 0x9e3779b97f4a7c15) ^ object.numbers.size();
+			for (double element : object.numbers)
+			{
+				hash ^= numberHash(element) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+			}
+			return hash;
+		});
+	default:
+		return typeHash;
+	}
+}
+
+BuiltinType::Object BuiltinType::intern(std::string const& phrase)
+{
+	static std::unordered_set<std::string> table;
+	static std::mutex tableMutex;
+
+	std::string const* canonical;
+	{
+		std::lock_guard<std::mutex> lock(tableMutex);
+		canonical = &*table.insert(phrase).first; // nodes never move, so the address is stable
+	}
+
+	Object object(phrase);
+	object.interned = canonical;
+	hashOf(object);
+	return object;
 }
\ No newline at end of file
@@ -3,13 +3,38 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
 #include <iostream>
+#include <memory_resource>
+#include <new>
+#include <cmath>
+
+#include "Hints.h"
+#include "SmallVector.h"
+
+// With --track-memory every Object made, copied, moved and destroyed is counted, see Memory.h
+#ifdef PTITSA_TRACK_MEMORY
+#include "Memory.h"
+#define PTITSA_TRACK(event, objectType) Library::Memory::count(Library::Memory::event, objectType)
+#else
+#define PTITSA_TRACK(event, objectType) ((void)0)
+#endif
 
 namespace BuiltinType
 {
 	struct Object
 	{
-		enum ObjectType { NOTHING = 0, NUMBER, PHRASE, BOOLEAN, LIST } type;
+		// NUMBER_LIST is a list holding only numbers, stored as contiguous doubles. It behaves exactly like a LIST,
+		// and becomes one (promoteToList) as soon as something other than a number has to go in
+		enum ObjectType { NOTHING = 0, NUMBER, PHRASE, BOOLEAN, LIST, NUMBER_LIST } type;
+
+		// Phrases and lists allocate through the default std::pmr memory resource, so that a program can
+		// swap the global heap for an arena (see Library::Arena).
+		// A list of up to four numbers is kept inside the Object and does not allocate at all. A LIST cannot do the same,
+		// as an Object cannot hold Objects inside itself
+		typedef std::pmr::string Phrase;
+		typedef std::pmr::vector<Object> List;
+		typedef SmallVector<double, 4> Numbers;
 
 		Object();
 		Object(double);
@@ -18,6 +43,11 @@ namespace BuiltinType
 		Object(bool);
 		Object(std::vector<Object>&&);
 		Object(std::vector<Object> const&);
+		Object(std::vector<double>&&);
+		Object(std::vector<double> const&);
+		Object(Phrase&&);
+		Object(List&&);
+		Object(Numbers&&);
 		
 		Object(const Object&);
 		Object(Object&&);
@@ -35,27 +65,153 @@ namespace BuiltinType
 		union 
 		{
 			double number;
-			std::string phrase;
+			Phrase phrase;
 			bool boolean;
-			std::vector<Object> list;
+			List list;
+			Numbers numbers;
 		};
 
+		// Set when the phrase came from the intern table: two interned phrases are equal exactly when these match
+		std::string const* interned = nullptr;
+
+		// Hashes of phrases and lists are kept once worked out. Anything changing a phrase or list in place
+		// (rather than through operator=) must call changedInPlace(). The iterations of a parallel loop may hash the same
+		// Object at once, so the hash is atomic and hashKnown is only set, with release, once it has been stored
+		mutable std::atomic<std::size_t> hash{ 0 };
+		mutable std::atomic<bool> hashKnown{ false };
+
 		void wipe();
+		void initAsCopyOf(Object const&);
 		void initAndSwapWith(Object&);
+		void changedInPlace();
+		bool isList() const;
+		std::size_t listSize() const;
+		void promoteToList();
 		std::string typeAsString() const;
 	};
 
+	// Phrase literals are interned once at startup, so comparing them is a pointer comparison
+	Object intern(std::string const&);
+
 	std::ostream& operator<<(std::ostream&, const Object&);	
 	bool areEqual(const Object&, const Object&);
+
+	// Consistent with areEqual, so Objects can be used as keys of hashed containers
+	std::size_t hashOf(Object const&);
+	struct ObjectHash { std::size_t operator()(Object const& object) const { return hashOf(object); } };
+	struct ObjectEquality { bool operator()(Object const& first, Object const& second) const { return areEqual(first, second); } };
 	
-	bool operator==(Object const&, Object const&);
-	bool operator!=(Object const&, Object const&);
-	
-	Object operator+(const Object&, const Object&);
-	Object operator-(const Object&, const Object&);
-	Object operator*(const Object&, const Object&);
-	Object operator/(const Object&, const Object&);
-	Object operator^(const Object&, const Object&);
+	// Two numbers are by far the most common operands, and are worked out inline.
+	// Anything else, meaning lists, phrases and the mistakes for types that do not go together, is handled by these
+	PTITSA_COLD bool areEqualSlowly(Object const&, Object const&);
+	PTITSA_COLD Object addSlowly(Object const&, Object const&);
+	PTITSA_COLD Object subtractSlowly(Object const&, Object const&);
+	PTITSA_COLD Object multiplySlowly(Object const&, Object const&);
+	PTITSA_COLD Object divideSlowly(Object const&, Object const&);
+	PTITSA_COLD Object raiseSlowly(Object const&, Object const&);
+
+	inline bool areEqual(Object const& first, Object const& second)
+	{
+		if (PTITSA_LIKELY(first.type == Object::NUMBER && second.type == Object::NUMBER)) return first.number == second.number;
+		return areEqualSlowly(first, second);
+	}
+
+	inline bool Object::operator==(Object const& other) { return areEqual(*this, other); }
+	inline bool operator==(Object const& first, Object const& second) { return areEqual(first, second); }
+	inline bool operator!=(Object const& first, Object const& second) { return !areEqual(first, second); }
+
+	inline Object operator+(Object const& first, Object const& second)
+	{
+		if (PTITSA_LIKELY(first.type == Object::NUMBER && second.type == Object::NUMBER)) return Object(first.number + second.number);
+		return addSlowly(first, second);
+	}
+	inline Object operator-(Object const& first, Object const& second)
+	{
+		if (PTITSA_LIKELY(first.type == Object::NUMBER && second.type == Object::NUMBER)) return Object(first.number - second.number);
+		return subtractSlowly(first, second);
+	}
+	inline Object operator*(Object const& first, Object const& second)
+	{
+		if (PTITSA_LIKELY(first.type == Object::NUMBER && second.type == Object::NUMBER)) return Object(first.number * second.number);
+		return multiplySlowly(first, second);
+	}
+	inline Object operator/(Object const& first, Object const& second)
+	{
+		if (PTITSA_LIKELY(first.type == Object::NUMBER && second.type == Object::NUMBER)) return Object(first.number / second.number);
+		return divideSlowly(first, second);
+	}
+	inline Object operator^(Object const& first, Object const& second)
+	{
+		if (PTITSA_LIKELY(first.type == Object::NUMBER && second.type == Object::NUMBER)) return Object(std::pow(first.number, second.number));
+		return raiseSlowly(first, second);
+	}
+
+	// Making, copying and destroying numbers is inline too, so that the operators above compile down to arithmetic on doubles
+	inline Object::Object()
+	{
+		new (&boolean) bool(true);
+		type = NOTHING;
+		PTITSA_TRACK(MADE, NOTHING);
+	}
+	inline Object::Object(double d)
+	{
+		new (&number) double(d);
+		type = NUMBER;
+		PTITSA_TRACK(MADE, NUMBER);
+	}
+	inline Object::Object(bool b)
+	{
+		new (&boolean) bool(b);
+		type = BOOLEAN;
+		PTITSA_TRACK(MADE, BOOLEAN);
+	}
+	inline Object::Object(Object const& other)
+	{
+		PTITSA_TRACK(COPIED, other.type);
+		if (PTITSA_LIKELY(other.type == NUMBER))
+		{
+			new (&number) double(other.number);
+			type = NUMBER;
+		}
+		else initAsCopyOf(other);
+	}
+	inline Object::Object(Object&& temp)
+	{
+		PTITSA_TRACK(MOVED, temp.type);
+		if (PTITSA_LIKELY(temp.type == NUMBER))
+		{
+			new (&number) double(temp.number);
+			type = NUMBER;
+		}
+		else initAndSwapWith(temp);
+	}
+	inline Object::~Object()
+	{
+		PTITSA_TRACK(DESTROYED, type);
+		if (PTITSA_UNLIKELY(type == PHRASE || type == LIST || type == NUMBER_LIST)) wipe();
+	}
+
+	inline Object& Object::operator=(Object temp)
+	{
+		if (PTITSA_LIKELY(type == NUMBER && temp.type == NUMBER)) number = temp.number;
+		else
+		{
+			wipe();
+			initAndSwapWith(temp);
+		}
+		return *this;
+	}
+	inline Object& Object::operator=(double d)
+	{
+		if (PTITSA_LIKELY(type == NUMBER)) number = d;
+		else
+		{
+			wipe();
+			new (&number) double(d);
+			type = NUMBER;
+		}
+		return *this;
+	}
 }
 
 #endif // !OBJECT_INCLUDE
@@ -1,23 +1,68 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
 
 #include "Object.h"
+#include "Kernels.h"
 #include "../Compiler/Mistake.h"
 #include "../Compiler/Util.h"
 
-BuiltinType::Object& BuiltinType::Object::operator=(double d)
+namespace
 {
-	wipe();
-	new (&number) double(d);
-	type = NUMBER;
-	return *this;
+	using namespace BuiltinType;
+
+	Object::List elementsOf(Object const& list)
+	{
+		if (list.type == Object::NUMBER_LIST) return Object::List(list.numbers.begin(), list.numbers.end());
+		return list.list;
+	}
+
+	Object promoted(Object const& numberList)
+	{
+		Object list = numberList;
+		list.promoteToList();
+		return list;
+	}
+
+	// Removes the first occurrence of each item in `toRemove` (counting repeats) in one pass over `list`,
+	// which is what removing them one at a time would give
+	Object::List withoutItems(Object::List const& list, Object::List const& toRemove)
+	{
+		std::unordered_map<std::reference_wrapper<Object const>, unsigned, ObjectHash, ObjectEquality> remaining;
+		remaining.reserve(toRemove.size());
+		for (Object const& item : toRemove) remaining[item]++;
+
+		unsigned stillToRemove = toRemove.size();
+		Object::List kept;
+		kept.reserve(list.size());
+
+		for (Object const& item : list)
+		{
+			if (stillToRemove > 0)
+			{
+				auto const found = remaining.find(item);
+				if (found != remaining.end() && found->second > 0)
+				{
+					found->second--;
+					stillToRemove--;
+					continue;
+				}
+			}
+			kept.push_back(item);
+		}
+
+		if (stillToRemove > 0) throw Mistake::Item_Not_In_List("Could not remove the items.");
+		return kept;
+	}
 }
+
 BuiltinType::Object& BuiltinType::Object::operator=(std::string string)
 {
 	wipe();
-	new (&phrase) std::string();
-	std::swap(phrase, string);
+	new (&phrase) Phrase(string.begin(), string.end());
 	type = PHRASE;
 	return *this;
 }
@@ -30,41 +75,46 @@ BuiltinType::Object& BuiltinType::Object::operator=(bool b)
 }
 BuiltinType::Object& BuiltinType::Object::operator=(std::vector<Object> vector)
 {
-	wipe();
-	new (&list) std::vector<Object>();
-	std::swap(list, vector);
-	type = LIST;
-	return *this;
-}
-BuiltinType::Object& BuiltinType::Object::operator=(Object temp)
-{
-	wipe();
-	initAndSwapWith(temp);
-	return *this;
+	return *this = Object(std::move(vector));
 }
 
-bool BuiltinType::Object::operator==(const Object& other) { return BuiltinType::areEqual(*this, other); }
+BuiltinType::Object BuiltinType::addSlowly(const Object& first, const Object& second)
+{
+	if (first.type == Object::NUMBER_LIST && second.type == Object::NUMBER)
+	{
+		Object::Numbers allNumbers;
+		allNumbers.reserve(first.numbers.size() + 1);
+		allNumbers.insert(allNumbers.end(), first.numbers.begin(), first.numbers.end());
+		allNumbers.push_back(second.number);
+		return Object(std::move(allNumbers));
+	}
 
-bool BuiltinType::operator==(const Object& first, const Object& second) { return areEqual(first, second); }
-bool BuiltinType::operator!=(Object const& first, Object const& second) { return !areEqual(first, second); }
+	else if (first.type == Object::NUMBER_LIST && second.type == Object::NUMBER_LIST)
+	{
+		Object::Numbers allNumbers;
+		allNumbers.reserve(first.numbers.size() + second.numbers.size());
+		allNumbers.insert(allNumbers.end(), first.numbers.begin(), first.numbers.end());
+		allNumbers.insert(allNumbers.end(), second.numbers.begin(), second.numbers.end());
+		return Object(std::move(allNumbers));
+	}
 
-BuiltinType::Object BuiltinType::operator+(const Object& first, const Object& second)
-{
-	if (first.type == Object::LIST)
+	else if (first.isList())
 	{
-		std::vector<Object> allObjects = first.list;
+		Object::List allObjects = elementsOf(first);
 		if (second.type == Object::LIST)
 		{
 			allObjects.insert(allObjects.end(), second.list.begin(), second.list.end());
 		}
+		else if (second.type == Object::NUMBER_LIST)
+		{
+			allObjects.insert(allObjects.end(), second.numbers.begin(), second.numbers.end());
+		}
 		else allObjects.push_back(second);
 
-		return Object(allObjects);
+		return Object(std::move(allObjects));
 	}
 
-	else if (second.type == Object::LIST) return second + first;
-
-	else if (first.type == Object::NUMBER && second.type == Object::NUMBER)  return Object(first.number + second.number);
+	else if (second.isList()) return second + first;
 
 	else if (first.type == Object::BOOLEAN && second.type == Object::BOOLEAN) return Object(first.boolean || second.boolean);
 
@@ -73,39 +123,52 @@ BuiltinType::Object BuiltinType::operator+(const Object& first, const Object& se
 	throw Mistake::Wrong_Type_Used("Could not add a " + first.typeAsString() + " and a " + second.typeAsString());
 }
 
-BuiltinType::Object BuiltinType::operator-(const Object& first, const Object& second)
+BuiltinType::Object BuiltinType::subtractSlowly(const Object& first, const Object& second)
 {
-	if (first.type == Object::LIST) // removing an element from first
+	if (first.type == Object::NUMBER_LIST)
+	{
+		if (second.type == Object::NUMBER) // removing a number, without leaving the dense representation
+		{
+			auto const found = std::find(first.numbers.begin(), first.numbers.end(), second.number);
+			if (found == first.numbers.end()) throw Mistake::Item_Not_In_List("Could not remove the item.");
+
+			Object::Numbers newNumbers;
+			newNumbers.reserve(first.numbers.size() - 1);
+			newNumbers.insert(newNumbers.end(), first.numbers.begin(), found);
+			newNumbers.insert(newNumbers.end(), found + 1, first.numbers.end());
+			return Object(std::move(newNumbers));
+		}
+		return promoted(first) - second;
+	}
+	else if (first.type == Object::LIST) // removing an element from first
 	{
-		std::vector<Object> newList = first.list;
 		unsigned removeIdx;
 
-		if (Util::couldSetIndex<Object>(newList, second, removeIdx))
+		if (Util::couldSetIndex(first.list, second, removeIdx))
 		{
+			Object::List newList = first.list;
 			newList.erase(newList.begin() + removeIdx);
-			return Object(newList);
+			return Object(std::move(newList));
 		}
 		else if (second.type == Object::LIST) // removing a sequence of items from first
 		{
-			for (const Object& toRemove : second.list)
-			{
-				if (Util::couldSetIndex(newList, toRemove, removeIdx)) newList.erase(newList.begin() + removeIdx);
-				else throw Mistake::Item_Not_In_List("Could not remove the items.");
-			}
+			return Object(withoutItems(first.list, second.list));
+		}
+		else if (second.type == Object::NUMBER_LIST)
+		{
+			return Object(withoutItems(first.list, elementsOf(second)));
 		}
 		else throw Mistake::Item_Not_In_List("Could not remove the item.");
 	}
-	else if (first.type == Object::NUMBER && second.type == Object::NUMBER) return Object(first.number - second.number);
 
 	throw Mistake::Wrong_Type_Used("Could not take away a " + first.typeAsString() + " from a " + second.typeAsString() + ".");
 }
 
-BuiltinType::Object BuiltinType::operator*(const Object& first, const Object& second)
+BuiltinType::Object BuiltinType::multiplySlowly(const Object& first, const Object& second)
 {
 	if (second.type == Object::NUMBER)
 	{
-		if (first.type == Object::NUMBER) return std::move(Object(first.number * second.number));
-		else
+		if (first.type != Object::NUMBER)
 		{
 			unsigned const secondNumberAsNatural = static_cast<unsigned>(second.number);
 			if (secondNumberAsNatural - second.number == 0 && second.number >= 0) // if second.number is a natural number
@@ -116,12 +179,18 @@ BuiltinType::Object BuiltinType::operator*(const Object& first, const Object& se
 					for (unsigned i = 0; i < secondNumberAsNatural; ++i) stringStream << first.phrase;
 					return Object(stringStream.str());
 				}
+				else if (first.type == Object::NUMBER_LIST)
+				{
+					Object::Numbers repeatedNumbers(first.numbers.size() * secondNumberAsNatural);
+					Kernels::repeat(first.numbers.data(), first.numbers.size(), repeatedNumbers.data(), secondNumberAsNatural);
+					return Object(std::move(repeatedNumbers));
+				}
 				else if (first.type == Object::LIST) // repeating a list n times
 				{
-					std::vector<Object> repeatedList;
+					Object::List repeatedList;
 					repeatedList.reserve(first.list.size() * secondNumberAsNatural);
 					for (unsigned i = 0; i < secondNumberAsNatural; ++i) repeatedList.insert(repeatedList.end(), first.list.begin(), first.list.end());
-					return Object(repeatedList);
+					return Object(std::move(repeatedList));
 				}
 			}
 			else
@@ -133,7 +202,7 @@ BuiltinType::Object BuiltinType::operator*(const Object& first, const Object& se
 		}		
 	}
 	else if (second.type == Object::NUMBER &&
-			(first.type == Object::PHRASE || first.type == Object::LIST)) // if arguments are like above, but the other way round
+			(first.type == Object::PHRASE || first.isList())) // if arguments are like above, but the other way round
 	{
 		return second * first;
 	}
@@ -141,15 +210,13 @@ BuiltinType::Object BuiltinType::operator*(const Object& first, const Object& se
 
 }
 
-BuiltinType::Object BuiltinType::operator/(const Object& first, const Object& second)
+BuiltinType::Object BuiltinType::divideSlowly(const Object& first, const Object& second)
 {
-	if (first.type == Object::NUMBER && second.type == Object::NUMBER) return Object(first.number / second.number);
 	throw Mistake::Wrong_Type_Used("Could not divide a " + first.typeAsString() + " by a " + second.typeAsString());
 }
 
-BuiltinType::Object BuiltinType::operator^(const Object& first, const Object& second)
+BuiltinType::Object BuiltinType::raiseSlowly(const Object& first, const Object& second)
 {
-	if (first.type == Object::NUMBER && second.type == Object::NUMBER) return Object(pow(first.number, second.number));
 	throw Mistake::Wrong_Type_Used("Could not raise a " + first.typeAsString() + " to the power of a " + second.typeAsString());
 }
 
@@ -158,6 +225,16 @@ std::ostream& BuiltinType::operator<<(std::ostream& ostream, const Object& objec
 	if (object.type == Object::NUMBER) ostream << object.number;
 	else if (object.type == Object::PHRASE) ostream << object.phrase;
 	else if (object.type == Object::BOOLEAN) ostream << (object.boolean ? "true" : "false");
+	else if (object.type == Object::NUMBER_LIST)
+	{
+		ostream << '[';
+		for (std::size_t i = 0; i < object.numbers.size(); ++i)
+		{
+			ostream << object.numbers[i];
+			if (i + 1 < object.numbers.size()) ostream << ", ";
+		}
+		ostream << ']';
+	}
 	else if (object.type == Object::LIST)
 	{
 		ostream << '[';
@@ -0,0 +1,287 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <utility>
+#include <string>
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+
+#include "Parallel.h"
+#include "Core.h"
+#include "../Compiler/Mistake.h"
+#ifdef PTITSA_TRACK_MEMORY
+#include "Memory.h"
+#endif
+
+namespace
+{
+	std::atomic<unsigned> loopsRunning(0);
+	thread_local bool inLoop = false;
+
+	// What is left of one thread's share of a loop. Others steal from its end, so it is only locked to take a piece or to be stolen from
+	struct alignas(64) Share
+	{
+		std::mutex mutex;
+		std::size_t begin = 0, end = 0;
+	};
+
+	// One parallel loop, worked on by every thread of the pool at once
+	class Loop
+	{
+	public:
+		Loop(std::size_t count, unsigned threads, std::function<void(std::size_t, std::size_t)> const & work) :
+			work(work),
+			shares(threads),
+			piece(std::max<std::size_t>(1, count / (threads * std::size_t(16)))),
+			failedAt(SIZE_MAX)
+#ifdef PTITSA_TRACK_MEMORY
+			, row(Library::Memory::currentRow)
+#endif
+		{
+			for (unsigned t = 0; t < threads; t++)
+			{
+				shares[t].begin = count * t / threads;
+				shares[t].end = count * (t + 1) / threads;
+			}
+		}
+
+		void run(unsigned thread)
+		{
+			inLoop = true;
+#ifdef PTITSA_TRACK_MEMORY
+			Library::Memory::Line line(row); // what the iterations do is the loop's line's, whichever thread runs them
+#endif
+			std::size_t begin, end;
+			while (couldTake(thread, begin, end))
+			{
+				if (begin > failedAt.load(std::memory_order_relaxed)) continue; // it would not have been reached
+
+				std::string shown;
+				Library::shownText = &shown;
+				try { work(begin, end); }
+				catch (...) { fail(begin, std::current_exception()); }
+				Library::shownText = nullptr;
+
+				if (!shown.empty())
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					output.emplace_back(begin, std::move(shown));
+				}
+			}
+			inLoop = false;
+		}
+
+		// Writes out what the pieces showed, in order, up to the failure if there was one, and then rethrows it
+		void finish()
+		{
+			std::sort(output.begin(), output.end(), [](auto const & first, auto const & second) { return first.first < second.first; });
+			for (auto const & shown : output)
+			{
+				if (shown.first > failedAt) break;
+				std::cout << shown.second;
+			}
+			if (failure) std::rethrow_exception(failure);
+		}
+
+	private:
+		std::function<void(std::size_t, std::size_t)> const & work;
+		std::vector<Share> shares;
+		std::size_t const piece;
+
+		std::atomic<std::size_t> failedAt; // where the earliest piece to fail so far began
+		std::mutex mutex; // for what follows
+		std::exception_ptr failure;
+		std::vector<std::pair<std::size_t, std::string>> output; // what each piece showed, by where it began
+#ifdef PTITSA_TRACK_MEMORY
+		unsigned const row; // the line the loop is on
+#endif
+
+		bool couldTake(unsigned thread, std::size_t & begin, std::size_t & end)
+		{
+			Share & own = shares[thread];
+			while (true)
+			{
+				{
+					std::lock_guard<std::mutex> lock(own.mutex);
+					if (own.begin < own.end)
+					{
+						begin = own.begin;
+						end = std::min(own.end, begin + piece);
+						own.begin = end;
+						return true;
+					}
+				}
+				if (!couldSteal(thread)) return false;
+			}
+		}
+
+		// Takes the second half of what another thread has left. Work is only ever moved, never made,
+		// so once every share is seen to be empty the loop has nothing left to hand out
+		bool couldSteal(unsigned thread)
+		{
+			for (unsigned i = 1; i < shares.size(); i++)
+			{
+				Share & victim = shares[(thread + i) % shares.size()];
+				std::size_t begin, end;
+				{
+					std::lock_guard<std::mutex> lock(victim.mutex);
+					if (victim.begin >= victim.end) continue;
+					begin = victim.begin + (victim.end - victim.begin) / 2;
+					end = victim.end;
+					victim.end = begin;
+				}
+				std::lock_guard<std::mutex> lock(shares[thread].mutex);
+				shares[thread].begin = begin;
+				shares[thread].end = end;
+				return true;
+			}
+			return false;
+		}
+
+		void fail(std::size_t begin, std::exception_ptr exception)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (begin < failedAt)
+			{
+				failure = exception;
+				failedAt = begin;
+			}
+		}
+	};
+
+	// The threads besides the one starting a loop. They wait for a loop, work on it until nothing is left, and wait again
+	class Pool
+	{
+	public:
+		explicit Pool(unsigned threads)
+		{
+			for (unsigned t = 1; t < threads; t++) workers.emplace_back([this, t] { wait(t); });
+		}
+
+		~Pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			woken.notify_all();
+			for (std::thread & worker : workers) worker.join();
+		}
+
+		unsigned threads() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+		void run(Loop & loop)
+		{
+			std::lock_guard<std::mutex> onlyOne(running); // loops started by separate threads of a program take turns
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				current = &loop;
+				generation++;
+				working = static_cast<unsigned>(workers.size());
+			}
+			woken.notify_all();
+
+			loop.run(0);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [this] { return working == 0; });
+			current = nullptr;
+		}
+
+	private:
+		std::vector<std::thread> workers;
+		std::mutex running;
+		std::mutex mutex; // for what follows
+		std::condition_variable woken, finished;
+		Loop * current = nullptr;
+		unsigned long generation = 0;
+		unsigned working = 0;
+		bool stopping = false;
+
+		void wait(unsigned thread)
+		{
+			unsigned long seen = 0;
+			while (true)
+			{
+				Loop * loop;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					woken.wait(lock, [&] { return stopping || generation != seen; });
+					if (stopping) return;
+					seen = generation;
+					loop = current;
+				}
+
+				loop->run(thread);
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--working == 0) finished.notify_one();
+			}
+		}
+	};
+
+	Pool & pool()
+	{
+		static Pool pool(Library::Parallel::threadCount());
+		return pool;
+	}
+}
+
+unsigned Library::Parallel::threadCount()
+{
+	if (char const * const threads = std::getenv("PTITSA_THREADS"))
+	{
+		int const count = std::atoi(threads);
+		if (count > 0) return static_cast<unsigned>(count);
+	}
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool Library::Parallel::isRunning() { return loopsRunning.load(std::memory_order_relaxed) > 0; }
+
+void Library::Parallel::forPieces(std::size_t count, std::function<void(std::size_t begin, std::size_t end)> const & work)
+{
+	if (count == 0) return;
+	if (inLoop) // its threads are all busy with the loop around this one
+	{
+		work(0, count);
+		return;
+	}
+
+	Pool & threads = pool();
+	if (threads.threads() == 1)
+	{
+		work(0, count);
+		return;
+	}
+
+	Loop loop(count, threads.threads(), work);
+	loopsRunning++;
+	threads.run(loop);
+	loopsRunning--;
+	loop.finish();
+}
+
+void Library::Parallel::putBack(BuiltinType::Object & items, std::vector<BuiltinType::Object> & changed)
+{
+	bool const allNumbers = std::all_of(changed.begin(), changed.end(), [](Object const & item) { return item.type == Object::NUMBER; });
+	if (items.type == Object::NUMBER_LIST && allNumbers)
+	{
+		for (std::size_t i = 0; i < changed.size(); i++) items.numbers[i] = changed[i].number;
+	}
+	else
+	{
+		items.promoteToList();
+		for (std::size_t i = 0; i < changed.size(); i++) items.list[i] = std::move(changed[i]);
+	}
+	items.changedInPlace();
+}
+
+void Library::Parallel::notAList(BuiltinType::Object const & items)
+{
+	throw Mistake::Wrong_Type_Used("Could not go over each item of a " + items.typeAsString());
+}
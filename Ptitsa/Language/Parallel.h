@@ -0,0 +1,93 @@
+#ifndef PARALLEL_INCLUDE
+#define PARALLEL_INCLUDE
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "Object.h"
+
+// Used by programs with `for each parallel` loops. The loops run on a pool of threads made the first time one runs
+namespace Library
+{
+	using namespace BuiltinType;
+
+	namespace Parallel
+	{
+		// How many threads a parallel loop runs on, counting the one that starts it: $PTITSA_THREADS, or one per hardware thread
+		unsigned threadCount();
+
+		// Whether a parallel loop is running, so that what the whole program shares, like an Arena, has to take turns
+		bool isRunning();
+
+		// Calls work(begin, end) on pieces of [0, count) until all of it is done, on every thread of the pool.
+		// Each thread starts with an equal share, and once that runs out takes half of what is left of another's,
+		// so iterations that take longer than others still keep every thread busy.
+		// What the pieces show is written out in order of the pieces once the loop ends.
+		// If a piece throws, the pieces after it are not started, and those before it are finished and shown,
+		// so the failure rethrown and what is shown before it are what running the pieces one after another gives.
+		// Called from inside a parallel loop, the whole loop runs on the thread it was called from
+		void forPieces(std::size_t count, std::function<void(std::size_t begin, std::size_t end)> const & work);
+
+		// Puts the items the body of a loop left in its variable back into the list
+		void putBack(Object & items, std::vector<Object> & changed);
+
+		[[noreturn]] PTITSA_COLD void notAList(Object const & items);
+	}
+
+	// `for each parallel x in items`. Each iteration's x is its own copy of its item, and the iterations run in no particular order.
+	// When the body assigns to x, what it leaves there is put back into the list once every iteration is done
+	template <typename Body> void forEachInParallel(Object & items, bool changesItems, Body const & body)
+	{
+		if (!items.isList()) Parallel::notAList(items);
+		std::size_t const count = items.listSize();
+
+		if (!changesItems)
+		{
+			if (items.type == Object::NUMBER_LIST)
+			{
+				Parallel::forPieces(count, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t i = begin; i < end; i++)
+					{
+						Object item(items.numbers[i]);
+						body(item);
+					}
+				});
+			}
+			else
+			{
+				Parallel::forPieces(count, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t i = begin; i < end; i++) body(items.list[i]);
+				});
+			}
+			return;
+		}
+
+		// Kept apart from the list until the end, as the body may read the list while other iterations change their items
+		std::vector<Object> changed(count);
+		Parallel::forPieces(count, [&](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t i = begin; i < end; i++)
+			{
+				changed[i] = items.type == Object::NUMBER_LIST ? Object(items.numbers[i]) : items.list[i];
+				body(changed[i]);
+			}
+		});
+		Parallel::putBack(items, changed);
+	}
+
+	// A list worked out for the loop, so there is nowhere to put items back
+	template <typename Body> void forEachInParallel(Object const & items, bool, Body const & body)
+	{
+		Object copy = items;
+		forEachInParallel(copy, false, body);
+	}
+	template <typename Body> void forEachInParallel(Object && items, bool, Body const & body)
+	{
+		forEachInParallel(items, false, body);
+	}
+}
+
+#endif // !PARALLEL_INCLUDE
@@ -0,0 +1,111 @@
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+#include "Profiler.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct LineCost
+	{
+		unsigned long long hits = 0;
+		Clock::duration time = Clock::duration::zero();
+	};
+
+	void addCosts(std::vector<LineCost> & total, std::vector<LineCost> const & costs)
+	{
+		if (total.size() < costs.size()) total.resize(costs.size());
+		for (unsigned row = 0; row < costs.size(); row++)
+		{
+			total[row].hits += costs[row].hits;
+			total[row].time += costs[row].time;
+		}
+	}
+
+	double milliseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	// Made by Profiler::start, before any thread has its own costs, so it is destroyed after all of them have been added in
+	struct Report
+	{
+		std::string sourceName;
+		Clock::time_point started;
+		bool isStarted = false;
+
+		std::mutex mutex;
+		std::vector<LineCost> lines;
+
+		~Report()
+		{
+			if (!isStarted) return;
+			Clock::duration const programTime = Clock::now() - started;
+
+			std::vector<unsigned> rows;
+			for (unsigned row = 0; row < lines.size(); row++)
+			{
+				if (lines[row].hits > 0) rows.push_back(row);
+			}
+			std::sort(rows.begin(), rows.end(), [this](unsigned first, unsigned second)
+			{
+				if (lines[first].time != lines[second].time) return lines[first].time > lines[second].time;
+				return lines[first].hits > lines[second].hits;
+			});
+
+			// Times are inclusive, so an if or while line also counts every line it runs
+			std::ostream & out = std::cerr;
+			out << "\nProfile of " << sourceName << ", " << std::fixed << std::setprecision(3) << milliseconds(programTime) << " ms in total\n";
+			out << std::setw(8) << "line" << std::setw(14) << "hits" << std::setw(14) << "time (ms)" << std::setw(10) << "share" << "\n";
+			for (unsigned row : rows)
+			{
+				double const share = programTime.count() > 0 ? 100.0 * lines[row].time.count() / programTime.count() : 0.0;
+				out << std::setw(8) << row
+					<< std::setw(14) << lines[row].hits
+					<< std::setw(14) << milliseconds(lines[row].time)
+					<< std::setw(9) << std::setprecision(1) << share << "%\n"
+					<< std::setprecision(3);
+			}
+		}
+	};
+
+	Report & report()
+	{
+		static Report report;
+		return report;
+	}
+
+	struct ThreadCosts
+	{
+		std::vector<LineCost> lines;
+
+		~ThreadCosts()
+		{
+			Report & total = report();
+			std::lock_guard<std::mutex> lock(total.mutex);
+			addCosts(total.lines, lines);
+		}
+	};
+
+	thread_local ThreadCosts threadCosts;
+}
+
+void Library::Profiler::start(std::string const & sourceName)
+{
+	Report & total = report();
+	total.sourceName = sourceName;
+	total.started = Clock::now();
+	total.isStarted = true;
+}
+
+void Library::Profiler::record(unsigned row, std::chrono::steady_clock::duration taken)
+{
+	std::vector<LineCost> & lines = threadCosts.lines;
+	if (row >= lines.size()) lines.resize(row + 1);
+	lines[row].hits++;
+	lines[row].time += taken;
+}
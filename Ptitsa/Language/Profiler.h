@@ -0,0 +1,43 @@
+#ifndef PROFILER_INCLUDE
+#define PROFILER_INCLUDE
+
+#include <chrono>
+#include <string>
+
+// Used by programs compiled with --profile. Each statement is timed by a Probe made for its source line,
+// and the cost is added up per thread, so timing a line never waits on a lock.
+// When the program ends, the lines are written to std::cerr, costliest first
+
+namespace Library
+{
+	namespace Profiler
+	{
+		// Starts the clock for the whole program. Must be called before the first Probe is made
+		void start(std::string const & sourceName);
+
+		void record(unsigned row, std::chrono::steady_clock::duration taken);
+
+		class Probe
+		{
+		public:
+			explicit Probe(unsigned row) : row(row), started(std::chrono::steady_clock::now()), stopped(false) { }
+			Probe(Probe const &) = delete;
+			Probe & operator=(Probe const &) = delete;
+			~Probe() { stop(); }
+
+			void stop()
+			{
+				if (stopped) return;
+				stopped = true;
+				record(row, std::chrono::steady_clock::now() - started);
+			}
+
+		private:
+			unsigned const row;
+			std::chrono::steady_clock::time_point const started;
+			bool stopped;
+		};
+	}
+}
+
+#endif // !PROFILER_INCLUDE
@@ -0,0 +1,160 @@
+#ifndef SMALL_VECTOR_INCLUDE
+#define SMALL_VECTOR_INCLUDE
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <memory_resource>
+#include <stdexcept>
+#include <type_traits>
+
+namespace BuiltinType
+{
+	// A vector that keeps up to InlineCapacity elements in itself, and only allocates once it grows past them.
+	// Most lists in programs are short, like pairs and coordinates, so most never allocate at all.
+	// Like std::pmr::vector it allocates through a memory resource, the default one when it was made.
+	// Elements are moved around as bytes, so they have to be trivially copyable
+	template <typename T, unsigned InlineCapacity> class SmallVector
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "SmallVector copies its elements as bytes");
+
+	public:
+		typedef T value_type;
+		typedef std::size_t size_type;
+		typedef T * iterator;
+		typedef T const * const_iterator;
+		typedef std::reverse_iterator<iterator> reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+		SmallVector() : count(0), capacity(InlineCapacity), resource(std::pmr::get_default_resource()) { }
+
+		// Value-initialised, like std::vector's
+		explicit SmallVector(size_type size) : SmallVector()
+		{
+			reserve(size);
+			std::fill_n(data(), size, T());
+			count = static_cast<std::uint32_t>(size);
+		}
+
+		template <typename Iterator, typename = typename std::iterator_traits<Iterator>::iterator_category>
+		SmallVector(Iterator first, Iterator last) : SmallVector() { insert(end(), first, last); }
+
+		// A copy allocates from the default resource, as a copy of a std::pmr::vector does
+		SmallVector(SmallVector const & other) : SmallVector() { insert(end(), other.begin(), other.end()); }
+
+		SmallVector(SmallVector && other) noexcept : count(other.count), capacity(other.capacity), resource(other.resource)
+		{
+			if (other.isInline()) std::memcpy(storage.elements, other.storage.elements, count * sizeof(T));
+			else
+			{
+				storage.heap = other.storage.heap;
+				other.capacity = InlineCapacity;
+			}
+			other.count = 0;
+		}
+
+		~SmallVector() { release(); }
+
+		SmallVector & operator=(SmallVector const & other)
+		{
+			if (this != &other)
+			{
+				count = 0;
+				insert(end(), other.begin(), other.end());
+			}
+			return *this;
+		}
+
+		SmallVector & operator=(SmallVector && other) noexcept
+		{
+			if (this == &other) return *this;
+			if (other.isInline() || *resource != *other.resource) return *this = static_cast<SmallVector const &>(other);
+
+			release();
+			storage.heap = other.storage.heap;
+			count = other.count;
+			capacity = other.capacity;
+			other.count = 0;
+			other.capacity = InlineCapacity;
+			return *this;
+		}
+
+		T * data() { return isInline() ? storage.elements : storage.heap; }
+		T const * data() const { return isInline() ? storage.elements : storage.heap; }
+
+		iterator begin() { return data(); }
+		iterator end() { return data() + count; }
+		const_iterator begin() const { return data(); }
+		const_iterator end() const { return data() + count; }
+		reverse_iterator rbegin() { return reverse_iterator(end()); }
+		reverse_iterator rend() { return reverse_iterator(begin()); }
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+		T & operator[](size_type i) { return data()[i]; }
+		T const & operator[](size_type i) const { return data()[i]; }
+
+		size_type size() const { return count; }
+		bool empty() const { return count == 0; }
+		static constexpr size_type max_size() { return UINT32_MAX; }
+
+		void reserve(size_type size)
+		{
+			if (size > capacity) moveTo(std::max<size_type>(size, capacity * size_type(2)));
+		}
+
+		void push_back(T const element)
+		{
+			if (count == capacity) reserve(count + size_type(1));
+			data()[count++] = element;
+		}
+
+		// As with std::vector, the range must not be in this vector
+		template <typename Iterator> iterator insert(const_iterator position, Iterator first, Iterator last)
+		{
+			size_type const offset = position - begin();
+			size_type const added = std::distance(first, last);
+			reserve(count + added);
+
+			T * const at = data() + offset;
+			std::memmove(at + added, at, (count - offset) * sizeof(T));
+			std::copy(first, last, at);
+			count += static_cast<std::uint32_t>(added);
+			return at;
+		}
+
+	private:
+		union Storage
+		{
+			T elements[InlineCapacity];
+			T * heap;
+
+			Storage() { }
+		} storage;
+		std::uint32_t count;
+		std::uint32_t capacity; // InlineCapacity exactly when the elements are in storage.elements
+		std::pmr::memory_resource * resource;
+
+		bool isInline() const { return capacity == InlineCapacity; }
+
+		void moveTo(size_type newCapacity)
+		{
+			if (newCapacity > max_size()) throw std::length_error("A list grew too long.");
+
+			T * const moved = static_cast<T *>(resource->allocate(newCapacity * sizeof(T), alignof(T)));
+			std::memcpy(moved, data(), count * sizeof(T));
+			release();
+			storage.heap = moved;
+			capacity = static_cast<std::uint32_t>(newCapacity);
+		}
+
+		void release()
+		{
+			if (!isInline()) resource->deallocate(storage.heap, capacity * sizeof(T), alignof(T));
+		}
+	};
+}
+
+#endif // !SMALL_VECTOR_INCLUDE
@@ -4,34 +4,113 @@
 #include <string>
 #include <set>
 
-#include "Compiler/Lexer.h"
-#include "Compiler/BuildContextTree.h"
+#include "Compiler/Compiler.h"
 #include "Compiler/Util.h"
-#include "Compiler/InterpretTree.h"
+#include "Compiler/IR.h"
+#include "Compiler/Driver.h"
+
+std::string const inputFile = "Ptitsa/program.pti";
+std::string const irFile = "Ptitsa/program.ptic";
 
 std::string getCode()
 {
-    std::string const inputFile = "Ptitsa/program.pti";
     std::ifstream file(inputFile);
     std::stringstream buffer;
     buffer << file.rdbuf();
     return buffer.str();
 }
 
-void writeCode(std::string const & cppCode)
+void writeFiles(std::vector<InterpretTree::SourceFile> const & files)
+{
+    for (InterpretTree::SourceFile const & file : files)
+    {
+        std::ofstream output("Ptitsa/" + file.name);
+        output << file.code;
+    }
+}
+
+void writeStatistics(Optimise::Statistics const & statistics, BuildAST::Nodes const & nodes)
+{
+    std::cerr << "Loop-invariant expressions hoisted: " << statistics.hoistedInvariants << "\n"
+              << "Common subexpressions shared: " << statistics.commonSubexpressions << "\n"
+              << "Evaluations eliminated by sharing: " << statistics.eliminatedEvaluations << "\n"
+              << "Syntax tree nodes: " << nodes.size() << ", using " << nodes.bytesUsed() << " bytes" << std::endl;
+}
+
+// What the compiler does besides writing C++
+struct Actions
 {
-    std::string const outputFile = "Ptitsa/program.cpp";
-    std::ofstream output(outputFile);
-    output << cppCode;
-    output.close();
+    bool showStatistics = false;
+    bool emitIR = false; // save the parsed program, for tools and for later runs
+    bool fromIR = false; // start from the saved program rather than the source
+    unsigned splitInto = 0; // files for the program's code, or 0 for the one program.cpp
+    bool run = false; // build the program, unless it was built before, and run it
+};
+
+// --arena or --arena=pool: phrases and lists allocate from a pool for the whole program
+// --arena=monotonic: they allocate from a buffer that only grows until the program ends
+// --profile: the program times each line of the source, and lists the costliest ones when it ends
+// --track-memory: the program counts the Objects and bytes each line of the source makes, copies and holds, and lists them when it ends.
+//     It and its runtime have to be built with PTITSA_TRACK_MEMORY defined, which --run does
+// --stats: after compiling, show what the optimisation passes did and how big the syntax trees were
+// --threads=N: render the C++ on at most N threads; the code is the same whatever N is
+// --split=N: spread the program over N files and a program.cmake listing them, so large programs build in parallel
+// --run: build the program with $CXX and run it. Built programs are cached, so one that has not changed is not built again
+// --emit-ir: also write the parsed program to Ptitsa/program.ptic
+// --from-ir: read the parsed program from Ptitsa/program.ptic instead of lexing and parsing the source
+InterpretTree::Options getOptions(int argc, char * argv[], Actions & actions)
+{
+    InterpretTree::Options options;
+    options.sourceName = inputFile;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string const argument = argv[i];
+
+        if (argument == "--arena" || argument == "--arena=pool") options.arena = InterpretTree::Options::POOL_ARENA;
+        else if (argument == "--arena=monotonic") options.arena = InterpretTree::Options::MONOTONIC_ARENA;
+        else if (argument == "--profile") options.profile = true;
+        else if (argument == "--track-memory") options.trackMemory = true;
+        else if (argument.rfind("--threads=", 0) == 0) options.threads = static_cast<unsigned>(std::stoul(argument.substr(10)));
+        else if (argument.rfind("--split=", 0) == 0) actions.splitInto = static_cast<unsigned>(std::stoul(argument.substr(8)));
+        else if (argument == "--stats") actions.showStatistics = true;
+        else if (argument == "--run") actions.run = true;
+        else if (argument == "--emit-ir") actions.emitIR = true;
+        else if (argument == "--from-ir") actions.fromIR = true;
+        else std::cerr << "Ignoring unknown option " << argument << std::endl;
+    }
+    return options;
 }
 
-int main()
+std::vector<BuildContextTree::ContextTree> parse(Ptitsa::Compiler const & compiler, Actions const & actions, BuildAST::Nodes & nodes)
 {
-    std::vector<Lexer::LexemeLine> lexemeDoc = Lexer::createTypedLexemes(getCode());
-    Lexer::parseTypedLexemes(lexemeDoc);
-    std::vector<BuildContextTree::ContextTree> trees = BuildContextTree::generateContextTrees(lexemeDoc);
-    writeCode(InterpretTree::treesToString(trees));
+    if (actions.fromIR) return IR::Program(irFile).toContextTrees(nodes);
 
+    std::vector<BuildContextTree::ContextTree> trees = compiler.parse(getCode(), nodes);
+
+    if (actions.emitIR) IR::write(irFile, nodes, trees);
+    return trees;
+}
+
+int main(int argc, char * argv[])
+{
+    Actions actions;
+    InterpretTree::Options const options = getOptions(argc, argv, actions);
+    Ptitsa::Compiler const compiler(options, actions.splitInto);
+
+    BuildAST::Nodes nodes;
+    std::vector<BuildContextTree::ContextTree> trees = parse(compiler, actions, nodes);
+
+    std::vector<InterpretTree::SourceFile> files;
+    Optimise::Statistics const statistics = compiler.generate(nodes, trees, [&files](InterpretTree::SourceFile const & file) { files.push_back(file); });
+    writeFiles(files);
+
+    if (actions.showStatistics) writeStatistics(statistics, nodes);
+
+    if (actions.run)
+    {
+        Driver::Toolchain toolchain;
+        if (options.trackMemory) toolchain.flags += " -DPTITSA_TRACK_MEMORY";
+        return Driver::run(Driver::cachedExecutable(files, "Ptitsa", toolchain));
+    }
     return 0;
-}
\ No newline at end of file
+}